@@ -20,8 +20,10 @@ SOURCES += \
 	src/client/client.cpp \
 	src/client/clientplayer.cpp \
 	src/client/clientstruct.cpp \
+	src/core/atom.cpp \
 	src/core/banpair.cpp \
 	src/core/card.cpp \
+	src/core/distancematrix.cpp \
 	src/core/engine.cpp \
 	src/core/general.cpp \
         src/core/jsonutils.cpp \
@@ -76,14 +78,21 @@ SOURCES += \
 	src/scenario/miniscenarios.cpp \
 	src/scenario/zombie-mode-scenario.cpp \
 	src/server/ai.cpp \
+	src/server/cardpile.cpp \
 	src/server/contestdb.cpp \
 	src/server/gamerule.cpp \
+	src/server/gamestate.cpp \
         src/server/generalselector.cpp \
+	src/server/luastatepool.cpp \
+	src/server/selfplay.cpp \
+	src/server/relationtable.cpp \
 	src/server/room.cpp \
+	src/server/roomscheduler.cpp \
 	src/server/roomthread.cpp \
 	src/server/roomthread1v1.cpp \
 	src/server/roomthread3v3.cpp \
 	src/server/server.cpp \
+	src/server/servermetrics.cpp \
 	src/server/serverplayer.cpp \
 	src/ui/button.cpp \
 	src/ui/cardcontainer.cpp \
@@ -105,6 +114,7 @@ SOURCES += \
 	src/util/detector.cpp \
 	src/util/nativesocket.cpp \
 	src/util/recorder.cpp \
+	src/util/replayanalyzer.cpp \
 	src/lua/print.c \
 	src/lua/lzio.c \
 	src/lua/lvm.c \
@@ -155,8 +165,10 @@ HEADERS += \
 	src/client/clientplayer.h \
 	src/client/clientstruct.h \
 	src/core/audio.h \
+	src/core/atom.h \
 	src/core/banpair.h \
 	src/core/card.h \
+	src/core/distancematrix.h \
 	src/core/engine.h \
 	src/core/general.h \
         src/core/jsonutils.h \
@@ -211,14 +223,21 @@ HEADERS += \
 	src/scenario/zombie-mode-scenario.h \
         src/core/settings.h\
 	src/server/ai.h \
+	src/server/cardpile.h \
 	src/server/contestdb.h \
 	src/server/gamerule.h \
+	src/server/gamestate.h \
         src/server/generalselector.h \
+	src/server/luastatepool.h \
+	src/server/selfplay.h \
+	src/server/relationtable.h \
 	src/server/room.h \
+	src/server/roomscheduler.h \
 	src/server/roomthread.h \
 	src/server/roomthread1v1.h \
 	src/server/roomthread3v3.h \
 	src/server/server.h \
+	src/server/servermetrics.h \
 	src/server/serverplayer.h \
 	src/ui/button.h \
 	src/ui/cardcontainer.h \
@@ -240,6 +259,7 @@ HEADERS += \
 	src/util/detector.h \
 	src/util/nativesocket.h \
 	src/util/recorder.h \
+	src/util/replayanalyzer.h \
 	src/util/socket.h \
 	src/lua/lzio.h \
 	src/lua/lvm.h \
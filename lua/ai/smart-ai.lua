@@ -70,6 +70,7 @@ function setInitialTables()
 	sgs.target = 				{loyalist = nil, rebel = nil, renegade = nil } -- obsolete
 	sgs.discard_pile =			global_room:getDiscardPile()
 	sgs.draw_pile = 			global_room:getDrawPile()
+	sgs.ai_belief =				{version = 0, refreshed = -1}
 	sgs.lose_equip_skill = 		"xiaoji|xuanfeng|nosxuanfeng"
 	sgs.need_kongcheng = 		"lianying|kongcheng"
 	sgs.masochism_skill = 		"fankui|jieming|yiji|ganglie|enyuan|nosenyuan|fangzhu|guixin|quanji|noszhenggong"
@@ -114,8 +115,16 @@ function SmartAI:initialize(player)
 		local method_name = string.sub(full_method_name, method_name_start)
 		local method = self[method_name]
 		if method then
+			-- filterEvent runs for every AI on every event and catches up by itself;
+			-- the refresh is protected too, so its errors are logged like the method's
+			local decide = function(...)
+				if method_name ~= "filterEvent" then
+					self:refreshPlayers()
+				end
+				return method(self, ...)
+			end
 			local success, result1, result2
-			success, result1, result2 = pcall(method, self, ...)
+			success, result1, result2 = pcall(decide, ...)
 			if not success then
 				self.room:writeToConsole(result1)
 				self.room:writeToConsole(method_name)
@@ -796,7 +805,8 @@ function sgs.backwardEvaluation(player)
 	elseif rest_players["renegade"] == 0 and rest_players["loyalist"] == 0 and rest_players["rebel"] == #unknowns then return "rebel"
 	end
 	
-	return "unknown"
+	-- the seats left can not tell, ask the intentions the player has shown so far
+	return global_room:getRelationTable():evaluateRole(player)
 end
 
 function sgs.modifiedRoleEvaluation()
@@ -1053,6 +1063,8 @@ function sgs.updateIntention(from, to, intention, card)
 	
 	sgs.ai_card_intention.general(from, to, intention) 
 	sgs.checkMisjudge(player)
+	global_room:getRelationTable():addIntention(from, to, intention)
+	sgs.invalidateBelief()
 end
 
 function sgs.updateIntentions(from, tos, intention, card)
@@ -1134,6 +1146,7 @@ function sgs.outputProcessValues(room)
 end
 
 function sgs.gameProcess(room)
+	if sgs.ai_belief and sgs.ai_belief.process then return sgs.ai_belief.process end
 	local rebel_num = sgs.current_mode_players["rebel"]
 	local loyal_num = sgs.current_mode_players["loyalist"]
 	if rebel_num == 0 and loyal_num> 0 then return "loyalist"
@@ -1435,14 +1448,44 @@ function SmartAI:updateRoleTargets()
 	end
 end
 
-function SmartAI:updatePlayers()
-	for _, aflag in ipairs(sgs.ai_global_flags) do
-		sgs[aflag] = nil
-	end
+-- Beliefs shared by all AIs of the room (every room has its own Lua state).
+-- The version moves once per event that may change who is a friend or an enemy,
+-- and on every intention update; each AI rebuilds its lists lazily, before its
+-- next decision, instead of all of them rebuilding on every event.
+function sgs.invalidateBelief()
+	sgs.ai_belief.version = sgs.ai_belief.version + 1
+end
+
+-- the room level part of updatePlayers, done once per version
+function sgs.refreshBelief()
+	local belief = sgs.ai_belief
+	if belief.refreshed == belief.version then return end
+	belief.refreshed = belief.version
 
 	sgs.discard_pile = global_room:getDiscardPile()
 	sgs.draw_pile = global_room:getDrawPile()
-	
+end
+
+function SmartAI:refreshPlayers()
+	if self.belief_version ~= sgs.ai_belief.version then
+		self:updatePlayers()
+		self.belief_version = sgs.ai_belief.version
+	end
+end
+
+function SmartAI:updatePlayers()
+	sgs.refreshBelief()
+
+	-- objectiveLevel asks for the game process once per player, it can not change meanwhile
+	local belief = sgs.ai_belief
+	belief.process = sgs.gameProcess(self.room)
+	local success, result = pcall(self.buildPlayerLists, self)
+	belief.process = nil
+	self.belief_version = belief.version
+	if not success then error(result) end
+end
+
+function SmartAI:buildPlayerLists()
 	if sgs.isRolePredictable() then
 		self.friends = sgs.QList2Table(self.lua_ai:getFriends())
 		table.insert(self.friends, self.player)
@@ -1572,18 +1615,29 @@ function SmartAI:filterEvent(event, player, data)
 			end
 		end
 	elseif event == sgs.CardUsed or event == sgs.CardEffect or event == sgs.GameStart or event == sgs.Death or event == sgs.PhaseChange then
-		self:updatePlayers()
+		-- once per event, the other AIs catch up in refreshPlayers before they decide;
+		-- the recorder keeps its lists current for the intention filters below
+		if self == sgs.recorder then
+			for _, aflag in ipairs(sgs.ai_global_flags) do
+				sgs[aflag] = nil
+			end
+			sgs.invalidateBelief()
+			self:refreshPlayers()
+		end
 	end
 	
+	if self ~= sgs.recorder then return end
+
 	if event == sgs.Death then
-		if self == sgs.recorder then self:updateAlivePlayerRoles() end
+		self:updateAlivePlayerRoles()
 	end
 	if event == sgs.PhaseChange then
-		if self.room:getCurrent():getPhase() == sgs.Player_NotActive then sgs.modifiedRoleEvaluation() end
+		if self.room:getCurrent():getPhase() == sgs.Player_NotActive then
+			sgs.modifiedRoleEvaluation()
+			sgs.invalidateBelief()
+		end
 	end
 
-	if self ~= sgs.recorder then return end
-	
 	if event == sgs.CardEffect then
 		local struct = data:toCardEffect()
 		local card = struct.card
@@ -2748,7 +2802,10 @@ function SmartAI:getTurnUse()
 end
 
 function SmartAI:activate(use)
-	self:updatePlayers()
+	for _, aflag in ipairs(sgs.ai_global_flags) do
+		sgs[aflag] = nil
+	end
+	self:refreshPlayers()
 	self:assignKeep(self.player:getHp(),true)
 	self.toUse  = self:getTurnUse()
 	self:sortByDynamicUsePriority(self.toUse)
@@ -40,14 +40,17 @@ function load_extensions(just_require)
 			local module_name = "extensions." .. name
 			local loaded = require(module_name)
 			
-			sgs.Sanguosha:addPackage(loaded.extension)
+			if not just_require then
+				sgs.Sanguosha:addPackage(loaded.extension)
+			end
 		end
 	end
 end
 
-load_extensions()
+-- room states only need the skills of the extensions, the engine has their packages
+load_extensions(room_state)
 
-local done_loading = sgs.Sanguosha:property("DoneLoading"):toBool()
+local done_loading = room_state or sgs.Sanguosha:property("DoneLoading"):toBool()
 if not done_loading then
 	load_translations()
 	done_loading = sgs.QVariant(true)
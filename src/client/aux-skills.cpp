@@ -5,6 +5,7 @@
 #include "clientplayer.h"
 #include "standard-skillcards.h"
 #include "engine.h"
+#include "exppattern.h"
 
 DiscardSkill::DiscardSkill()
     :ViewAsSkill("discard"), card(new DummyCard),
@@ -50,13 +51,25 @@ const Card *DiscardSkill::viewAs(const QList<CardItem *> &cards) const{
 // -------------------------------------------
 
 ResponseSkill::ResponseSkill()
-    :OneCardViewAsSkill("response-skill")
+    :OneCardViewAsSkill("response-skill"), pattern(NULL), exp_pattern(NULL)
 {
 
 }
 
+ResponseSkill::~ResponseSkill(){
+    delete exp_pattern;
+}
+
 void ResponseSkill::setPattern(const QString &pattern){
-    this->pattern = Sanguosha->getPattern(pattern);
+    const CardPattern *ptn = Sanguosha->getPattern(pattern);
+
+    // the engine frees cached expression patterns once they fall out of
+    // its cache, while this skill holds its pattern until the next prompt
+    const ExpPattern *exp = dynamic_cast<const ExpPattern *>(ptn);
+    delete exp_pattern;
+    exp_pattern = exp ? new ExpPattern(*exp) : NULL;
+
+    this->pattern = exp_pattern ? exp_pattern : ptn;
 }
 
 bool ResponseSkill::matchPattern(const Player *player, const Card *card) const{
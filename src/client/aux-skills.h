@@ -24,12 +24,14 @@ private:
 };
 
 class CardPattern;
+class ExpPattern;
 
 class ResponseSkill: public OneCardViewAsSkill{
     Q_OBJECT
 
 public:
     ResponseSkill();
+    ~ResponseSkill();
     bool matchPattern(const Player *player, const Card *card) const;
 
     virtual void setPattern(const QString &pattern);
@@ -38,6 +40,7 @@ public:
 
 private:
     const CardPattern *pattern;
+    ExpPattern *exp_pattern;
 };
 
 class FreeDiscardSkill: public ViewAsSkill{
@@ -27,7 +27,7 @@ Client *ClientInstance = NULL;
 
 Client::Client(QObject *parent, const QString &filename)
     :QObject(parent), m_isDiscardActionRefusable(true), isCardShowOrPindian(false), WillDiscard(false),
-    status(NotActive), alive_count(1), swap_pile(0)
+    status(NotActive), alive_count(1), swap_pile(0), keyframe_count(0)
 {
     ClientInstance = this;
     m_isGameOver = false;
@@ -194,6 +194,7 @@ Client::Client(QObject *parent, const QString &filename)
 
         connect(socket, SIGNAL(message_got(char*)), recorder, SLOT(record(char*)));
         connect(socket, SIGNAL(message_got(char*)), this, SLOT(processServerPacket(char*)));
+        connect(socket, SIGNAL(frame_got(QByteArray)), this, SLOT(processServerFrame(QByteArray)));
         connect(socket, SIGNAL(error_message(QString)), this, SIGNAL(error_message(QString)));
         socket->connectToHost();
 
@@ -272,6 +273,8 @@ void Client::setup(const QString &setup_str){
     if(ServerInfo.parse(setup_str)){
         emit server_connected();
         request("toggleReady .");
+        if(ServerInfo.BinaryPacket)
+            request("binaryPacket .");
     }else{
         QMessageBox::warning(NULL, tr("Warning"), tr("Setup string can not be parsed: %1").arg(setup_str));
     }
@@ -294,18 +297,32 @@ void Client::processServerPacket(char *cmd){
     if (m_isGameOver) return;
     QSanGeneralPacket packet;
     if (packet.parse(cmd))
+        _processPacket(packet);
+    else processReply(cmd);
+}
+
+void Client::processServerFrame(const QByteArray &payload){
+    if (m_isGameOver) return;
+    QSanGeneralPacket packet;
+    if (!packet.parseBinary(std::string(payload.constData(), payload.size())))
+        return;
+
+    // replays only understand the text form
+    if (recorder)
+        recorder->recordLine(toQString(packet.toString()));
+    _processPacket(packet);
+}
+
+void Client::_processPacket(const QSanGeneralPacket &packet){
+    if (packet.getPacketType() == S_SERVER_NOTIFICATION)
     {
-        if (packet.getPacketType() == S_SERVER_NOTIFICATION)
-        {
-            CallBack callback = m_callbacks[packet.getCommandType()];
-            if (callback) {
-                (this->*callback)(packet.getMessageBody());
-            }
+        CallBack callback = m_callbacks[packet.getCommandType()];
+        if (callback) {
+            (this->*callback)(packet.getMessageBody());
         }
-        else if (packet.getPacketType() == S_SERVER_REQUEST)
-            processServerRequest(packet);
     }
-    else processReply(cmd);
+    else if (packet.getPacketType() == S_SERVER_REQUEST)
+        processServerRequest(packet);
 }
 
 bool Client::processServerRequest(const QSanGeneralPacket& packet)
@@ -660,6 +677,11 @@ void Client::startGame(const QString &){
     QList<ClientPlayer *> players = findChildren<ClientPlayer *>();
     alive_count = players.count();
 
+    if(recorder){
+        foreach(ClientPlayer *player, players)
+            connect(player, SIGNAL(phase_changed()), this, SLOT(onPlayerPhaseChanged()), Qt::UniqueConnection);
+    }
+
     emit game_started();
 }
 
@@ -1033,6 +1055,95 @@ void Client::kick(const QString &to_kick){
     request("kick " + to_kick);
 }
 
+void Client::onPlayerPhaseChanged(){
+    const ClientPlayer *player = qobject_cast<const ClientPlayer *>(sender());
+    if(player && player->getPhase() == Player::RoundStart)
+        recordKeyframe();
+}
+
+static void MarshalCards(QStringList &lines, int move_id, const ClientPlayer *player,
+                         Player::Place place, const QList<int> &card_ids, const QString &pile_name = QString())
+{
+    if(card_ids.isEmpty())
+        return;
+
+    // taken from the draw pile while marshalling, so the pile number stays
+    CardsMoveStruct move;
+    move.card_ids = card_ids;
+    move.from_place = Player::DrawPile;
+    move.to_place = place;
+    move.to_player_name = player->objectName();
+    move.to_pile_name = pile_name;
+    move.open = !card_ids.contains(Card::S_UNKNOWN_CARD_ID);
+
+    Json::Value arg(Json::arrayValue);
+    arg[0] = move_id;
+    arg[1] = move.toJsonValue();
+
+    QSanGeneralPacket lose(S_SERVER_NOTIFICATION, S_COMMAND_LOSE_CARD);
+    lose.setMessageBody(arg);
+    QSanGeneralPacket get(S_SERVER_NOTIFICATION, S_COMMAND_GET_CARD);
+    get.setMessageBody(arg);
+
+    lines << toQString(lose.toString()) << toQString(get.toString());
+}
+
+void Client::recordKeyframe(){
+    // the same as what Room::marshal sends to a reconnecting player,
+    // built from what this client knows
+    QStringList lines;
+    lines << QString(".role %1").arg(Self->getRole())
+          << ".flags marshalling";
+
+    QStringList player_circle;
+    foreach(const ClientPlayer *player, players)
+        player_circle << player->objectName();
+
+    lines << QString("arrangeSeats %1").arg(player_circle.join("+"))
+          << "startInXs 0";
+
+    foreach(const ClientPlayer *player, players){
+        lines << player->propertyLine("general");
+        if(player->getGeneral2())
+            lines << player->propertyLine("general2");
+    }
+
+    lines << "startGame .";
+
+    int move_id = 0;
+    foreach(const ClientPlayer *player, players){
+        player->marshal(lines);
+
+        QList<int> hand;
+        if(player == Self){
+            foreach(const Card *card, player->getCards())
+                hand << card->getId();
+        }else{
+            for(int i = 0; i < player->getHandcardNum(); i++)
+                hand << Card::S_UNKNOWN_CARD_ID;
+        }
+        MarshalCards(lines, --move_id, player, Player::PlaceHand, hand);
+
+        QList<int> equips;
+        foreach(const Card *card, player->getEquips())
+            equips << card->getId();
+        MarshalCards(lines, --move_id, player, Player::PlaceEquip, equips);
+
+        QList<int> judging;
+        foreach(const Card *card, player->getJudgingArea())
+            judging << card->getId();
+        MarshalCards(lines, --move_id, player, Player::PlaceDelayedTrick, judging);
+
+        foreach(QString pile_name, player->getPileNames())
+            MarshalCards(lines, --move_id, player, Player::PlaceSpecial, player->getPile(pile_name), pile_name);
+    }
+
+    lines << ".flags -marshalling"
+          << QString("setPileNumber %1").arg(pile_num);
+
+    recorder->recordKeyframe(++keyframe_count, lines);
+}
+
 bool Client::save(const QString &filename) const{
     if(recorder)
         return recorder->save(filename);
@@ -253,26 +253,31 @@ private:
     QString card_pattern;
     QString skill_to_invoke;
     int swap_pile;
+    int keyframe_count;
 
     unsigned int _m_lastServerSerial;
 
     void updatePileNum();
     void setPromptList(const QStringList &text);
     void commandFormatWarning(const QString &str, const QRegExp &rx, const char *command);
+    void recordKeyframe();
 
     void _askForCardOrUseCard(const Json::Value&);
+    void _processPacket(const QSanProtocol::QSanGeneralPacket &packet);
     bool _loseSingleCard(int card_id, CardsMoveStruct move);
     bool _getSingleCard(int card_id, CardsMoveStruct move);
 
 private slots:
     void processServerPacket(const QString &cmd);
     void processServerPacket(char *cmd);
+    void processServerFrame(const QByteArray &payload);
     bool processServerRequest(const QSanProtocol::QSanGeneralPacket& packet);
     void processReply(char *reply);
     void notifyRoleChange(const QString &new_role);
     void onPlayerChooseSuit();
     void onPlayerChooseKingdom();
     void clearTurnTag();
+    void onPlayerPhaseChanged();
     void onPlayerChooseOrder();
     void onPlayerChooseRole3v3();
 
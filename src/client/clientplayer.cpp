@@ -3,6 +3,7 @@
 #include "client.h"
 #include "engine.h"
 #include "standard.h"
+#include "atom.h"
 
 #include <QTextDocument>
 #include <QTextOption>
@@ -165,22 +166,24 @@ void ClientPlayer::setFlags(const QString &flag){
 }
 
 void ClientPlayer::setMark(const QString &mark, int value){
-    if(marks[mark] == value)
+    int mark_atom = AtomTable::Intern(mark);
+    if(marks[mark_atom] == value)
         return;
 
-    marks[mark] = value;
+    marks[mark_atom] = value;
 
     if(!mark.startsWith("@"))
         return;
 
     // set mark doc
     QString text = "";
-    QMapIterator<QString, int> itor(marks);
+    QMapIterator<int, int> itor(marks);
     while(itor.hasNext()){
         itor.next();
 
-        if(itor.key().startsWith("@") && itor.value() > 0){
-            QString mark_text = QString("<img src='image/mark/%1.png' />").arg(itor.key());
+        QString mark_name = AtomTable::Name(itor.key());
+        if(mark_name.startsWith("@") && itor.value() > 0){
+            QString mark_text = QString("<img src='image/mark/%1.png' />").arg(mark_name);
             if(itor.value() != 1)
                 mark_text.append(QString("x%1").arg(itor.value()));
             text.append(mark_text);
@@ -190,6 +193,51 @@ void ClientPlayer::setMark(const QString &mark, int value){
     mark_doc->setHtml(text);
 }
 
+QString ClientPlayer::propertyLine(const char *property_name) const{
+    QString value = property(property_name).toString();
+    if(this == Self)
+        return QString(".%1 %2").arg(property_name).arg(value);
+    else
+        return QString("#%1 %2 %3").arg(objectName()).arg(property_name).arg(value);
+}
+
+void ClientPlayer::marshal(QStringList &lines) const{
+    lines << propertyLine("maxhp") << propertyLine("hp");
+
+    if(getGeneral() && getKingdom() != getGeneral()->getKingdom())
+        lines << propertyLine("kingdom");
+
+    if(isAlive()){
+        lines << propertyLine("seat");
+        if(getPhase() != Player::NotActive)
+            lines << propertyLine("phase");
+    }else{
+        lines << propertyLine("alive") << propertyLine("role")
+              << QString("killPlayer %1").arg(objectName());
+    }
+
+    if(!faceUp())
+        lines << propertyLine("faceup");
+
+    if(isChained())
+        lines << propertyLine("chained");
+
+    QMapIterator<int, int> itor(marks);
+    while(itor.hasNext()){
+        itor.next();
+
+        QString mark_name = AtomTable::Name(itor.key());
+        if(mark_name.startsWith("@") && itor.value() != 0)
+            lines << QString("setMark %1.%2=%3").arg(objectName()).arg(mark_name).arg(itor.value());
+    }
+
+    foreach(QString skill_name, acquired_skills)
+        lines << QString("acquireSkill %1:%2").arg(objectName()).arg(skill_name);
+
+    foreach(int flag, flags)
+        lines << QString("#%1 flags %2").arg(objectName()).arg(AtomTable::Name(flag));
+}
+
 void ClientPlayer::changeReady(){
     setReady(!isReady());
     ClientInstance->ready();
@@ -32,6 +32,10 @@ public:
     virtual bool isLastHandCard(const Card *card) const;
     virtual void setMark(const QString &mark, int value);
 
+    // the lines ServerPlayer::marshal would send, cards excluded
+    QString propertyLine(const char *property_name) const;
+    void marshal(QStringList &lines) const;
+
 private:
     int handcard_num;
     QList<const Card *> known_cards;
@@ -73,6 +73,7 @@ bool ServerInfoStruct::parse(const QString &str){
     EnableAI = flags.contains("A");
     DisableChat = flags.contains("M");
     EnableSnatchHero = flags.contains("Q");
+    BinaryPacket = flags.contains("P");
 
     if(flags.contains("1"))
         MaxHPScheme = 1;
@@ -27,6 +27,7 @@ struct ServerInfoStruct{
     bool EnableAI;
     bool DisableChat;
     bool EnableSnatchHero;
+    bool BinaryPacket;
     int MaxHPScheme;
 };
 
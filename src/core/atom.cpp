@@ -0,0 +1,78 @@
+#include "atom.h"
+
+#include <QHash>
+#include <QStringList>
+#include <QReadWriteLock>
+#include <QThreadStorage>
+#include <QAtomicInt>
+
+struct Atoms{
+    QHash<QString, int> ids;
+    QStringList names;
+    QReadWriteLock lock;
+    QAtomicInt count;
+};
+
+// constructed on first use, so atoms can be interned during static initialization
+static Atoms &GetAtoms(){
+    static Atoms atoms;
+    return atoms;
+}
+
+// Every thread looks names up in its own copy of the table, which it refreshes
+// under the lock only when the table has grown since, so lookups of known
+// names and repeated misses never touch the lock.
+struct AtomSnapshot{
+    QHash<QString, int> ids;
+    QStringList names;
+};
+
+static AtomSnapshot *GetSnapshot(bool refresh){
+    static QThreadStorage<AtomSnapshot *> snapshots;
+    if(!snapshots.hasLocalData())
+        snapshots.setLocalData(new AtomSnapshot);
+
+    AtomSnapshot *snapshot = snapshots.localData();
+    Atoms &atoms = GetAtoms();
+    if(refresh && snapshot->names.length() != atoms.count.fetchAndAddOrdered(0)){
+        QReadLocker locker(&atoms.lock);
+        snapshot->ids = atoms.ids;
+        snapshot->names = atoms.names;
+    }
+
+    return snapshot;
+}
+
+int AtomTable::Intern(const QString &name){
+    int atom = Find(name);
+    if(atom != -1)
+        return atom;
+
+    Atoms &atoms = GetAtoms();
+    QWriteLocker locker(&atoms.lock);
+    QHash<QString, int>::const_iterator it = atoms.ids.constFind(name);
+    if(it != atoms.ids.constEnd())
+        return it.value();
+
+    atom = atoms.names.length();
+    atoms.names << name;
+    atoms.ids.insert(name, atom);
+    atoms.count.fetchAndStoreOrdered(atoms.names.length());
+    return atom;
+}
+
+int AtomTable::Find(const QString &name){
+    int atom = GetSnapshot(false)->ids.value(name, -1);
+    if(atom == -1)
+        atom = GetSnapshot(true)->ids.value(name, -1);
+
+    return atom;
+}
+
+QString AtomTable::Name(int atom){
+    AtomSnapshot *snapshot = GetSnapshot(false);
+    if(atom >= snapshot->names.length())
+        snapshot = GetSnapshot(true);
+
+    return snapshot->names.value(atom);
+}
@@ -0,0 +1,23 @@
+#ifndef ATOM_H
+#define ATOM_H
+
+#include <QString>
+
+// Skill, flag and mark names are interned into small integers once,
+// so that hot lookups on players compare integers instead of hashing strings.
+// Atoms are never released and are shared by all rooms.
+// Find and Name read a per-thread copy of the table and take no lock unless
+// the table has grown; the string overloads on Player still hash the name
+// once per call, so hot paths keep static int atoms instead.
+class AtomTable{
+public:
+    // returns the atom of the name, registering it when it is new
+    static int Intern(const QString &name);
+
+    // returns -1 if the name has never been interned
+    static int Find(const QString &name);
+
+    static QString Name(int atom);
+};
+
+#endif // ATOM_H
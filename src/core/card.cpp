@@ -28,6 +28,15 @@ Card::Card(Suit suit, int number, bool target_fixed)
         number = 0;
 }
 
+Card::~Card(){
+    // parsed cards deleted by their users must not be freed again by the room
+    if(isVirtualCard()){
+        Room *room = Room::GetCurrentRoom();
+        if(room)
+            room->forgetVirtualCard(this);
+    }
+}
+
 QString Card::getSuitString() const{
     return Suit2String(suit);
 }
@@ -280,82 +289,163 @@ bool Card::isVirtualCard() const{
     return id < 0;
 }
 
-const Card *Card::Parse(const QString &str){
-    static QMap<QString, Card::Suit> suit_map;
-    if(suit_map.isEmpty()){
-        suit_map.insert("spade", Card::Spade);
-        suit_map.insert("club", Card::Club);
-        suit_map.insert("heart", Card::Heart);
-        suit_map.insert("diamond", Card::Diamond);
-        suit_map.insert("no_suit", Card::NoSuit);
+// card strings used to be matched by regular expressions, which were rebuilt
+// on every call; the helpers below match the same grammar by hand
+
+static inline bool IsWordChar(QChar c){
+    return c.isLetterOrNumber() || c.isMark() || c == QChar('_');
+}
+
+// returns the end of the \w* run starting at from
+static int SkipWord(const QString &str, int from){
+    int i = from;
+    while(i < str.length() && IsWordChar(str.at(i)))
+        i++;
+    return i;
+}
+
+// same result as QString::toInt, without making a copy
+static int ParseInt(const QStringRef &str){
+    int from = 0, to = str.length();
+    while(from < to && str.at(from).isSpace())
+        from++;
+    while(to > from && str.at(to - 1).isSpace())
+        to--;
+
+    bool negative = false;
+    if(from < to && (str.at(from) == QChar('-') || str.at(from) == QChar('+'))){
+        negative = str.at(from) == QChar('-');
+        from++;
     }
 
+    if(from == to)
+        return 0;
+
+    int value = 0;
+    for(int i = from; i < to; i++){
+        QChar c = str.at(i);
+        if(c < QChar('0') || c > QChar('9'))
+            return 0;
+        value = value * 10 + (c.unicode() - '0');
+    }
+
+    return negative ? -value : value;
+}
+
+static Card::Suit ParseSuit(const QStringRef &suit){
+    if(suit == QLatin1String("spade"))
+        return Card::Spade;
+    else if(suit == QLatin1String("club"))
+        return Card::Club;
+    else if(suit == QLatin1String("heart"))
+        return Card::Heart;
+    else if(suit == QLatin1String("diamond"))
+        return Card::Diamond;
+    else
+        return Card::NoSuit;
+}
+
+static int ParseNumber(const QStringRef &number){
+    if(number == QLatin1String("A"))
+        return 1;
+    else if(number == QLatin1String("J"))
+        return 11;
+    else if(number == QLatin1String("Q"))
+        return 12;
+    else if(number == QLatin1String("K"))
+        return 13;
+    else
+        return ParseInt(number);
+}
+
+// adds the '+' separated ids in [from, to) unless they are just "."
+static void ParseSubcards(Card *card, const QString &str, int from, int to){
+    if(to - from == 1 && str.at(from) == QChar('.'))
+        return;
+
+    while(true){
+        int plus = str.indexOf(QChar('+'), from);
+        if(plus == -1 || plus >= to){
+            card->addSubcard(ParseInt(str.midRef(from, to - from)));
+            return;
+        }
+
+        card->addSubcard(ParseInt(str.midRef(from, plus - from)));
+        from = plus + 1;
+    }
+}
+
+// matches "[^:]+(:.+)?" up to the end of str; the user string starts at user_from, or is -1 if absent
+static bool MatchSubcardTail(const QString &str, int from, int &subcard_end, int &user_from){
+    int colon = str.indexOf(QChar(':'), from);
+    if(colon == -1){
+        subcard_end = str.length();
+        user_from = -1;
+        return subcard_end > from;
+    }
+
+    subcard_end = colon;
+    user_from = colon + 1;
+    return subcard_end > from && user_from < str.length();
+}
+
+const Card *Card::Parse(const QString &str){
+    const Card *card = NULL;
+
     if(str.startsWith(QChar('@'))){
-        // skill card
-        QRegExp pattern("@(\\w+)=([^:]+)(:.+)?");
-        QRegExp ex_pattern("@(\\w*)\\[(\\w+):(.+)\\]=([^:]+)(:.+)?");
-
-        QStringList texts;
-        QString card_name, card_suit, card_number;
-        QStringList subcard_ids;
-        QString subcard_str;
-        QString user_string;
-
-        if(pattern.exactMatch(str)){
-            texts = pattern.capturedTexts();
-            card_name = texts.at(1);
-            subcard_str = texts.at(2);
-            user_string = texts.at(3);
+        // skill card, either "@Name=subcards(:user_string)?"
+        // or "@Name[suit:number]=subcards(:user_string)?"
+        int name_end = SkipWord(str, 1);
+        int suit_end = -1, number_from = -1, number_end = -1;
+        int subcard_from = -1, subcard_end = -1, user_from = -1;
+        bool matched = false;
+
+        if(name_end > 1 && name_end < str.length() && str.at(name_end) == QChar('=')){
+            subcard_from = name_end + 1;
+            matched = MatchSubcardTail(str, subcard_from, subcard_end, user_from);
         }
-        else if(ex_pattern.exactMatch(str)){
-            texts = ex_pattern.capturedTexts();
-            card_name = texts.at(1);
-            card_suit = texts.at(2);
-            card_number = texts.at(3);
-            subcard_str = texts.at(4);
-            user_string = texts.at(5);
+
+        if(!matched && name_end < str.length() && str.at(name_end) == QChar('[')){
+            suit_end = SkipWord(str, name_end + 1);
+            if(suit_end > name_end + 1 && suit_end < str.length() && str.at(suit_end) == QChar(':')){
+                // the number is greedy, so the last "]=" with a valid tail ends it
+                number_from = suit_end + 1;
+                int pos = str.lastIndexOf("]=");
+                while(pos > number_from){
+                    subcard_from = pos + 2;
+                    if(MatchSubcardTail(str, subcard_from, subcard_end, user_from)){
+                        number_end = pos;
+                        matched = true;
+                        break;
+                    }
+                    pos = str.lastIndexOf("]=", pos - 1);
+                }
+            }
         }
-        else
-            return NULL;
 
-        if(subcard_str != ".")
-            subcard_ids = subcard_str.split("+");
+        if(!matched)
+            return NULL;
 
-        SkillCard *card = Sanguosha->cloneSkillCard(card_name);
+        QString card_name = str.mid(1, name_end - 1);
+        SkillCard *skill_card = Sanguosha->cloneSkillCard(card_name);
 
-        if(card == NULL)
+        if(skill_card == NULL)
             return NULL;
 
-        foreach(QString subcard_id, subcard_ids)
-            card->addSubcard(subcard_id.toInt());
+        ParseSubcards(skill_card, str, subcard_from, subcard_end);
 
         // skill name
         QString skill_name = card_name.remove("Card").toLower();
-        card->setSkillName(skill_name);
-        if(!card_suit.isEmpty())
-            card->setSuit(suit_map.value(card_suit, Card::NoSuit));
-        if(!card_number.isEmpty()){
-            int number = 0;
-            if(card_number == "A")
-                number = 1;
-            else if(card_number == "J")
-                number = 11;
-            else if(card_number == "Q")
-                number = 12;
-            else if(card_number == "K")
-                number = 13;
-            else
-                number = card_number.toInt();
-
-            card->setNumber(number);
+        skill_card->setSkillName(skill_name);
+        if(number_end != -1){
+            skill_card->setSuit(ParseSuit(str.midRef(name_end + 1, suit_end - name_end - 1)));
+            skill_card->setNumber(ParseNumber(str.midRef(number_from, number_end - number_from)));
         }
 
-        if(!user_string.isEmpty()){
-            user_string.remove(0, 1);
-            card->setUserString(user_string);
-        }
+        if(user_from != -1)
+            skill_card->setUserString(str.mid(user_from));
 
-        return card;
+        card = skill_card;
     }else if(str.startsWith(QChar('$'))){
         QString copy = str;
         copy.remove(QChar('$'));
@@ -365,48 +455,42 @@ const Card *Card::Parse(const QString &str){
             dummy->addSubcard(card_str.toInt());
         }
 
-        return dummy;
+        card = dummy;
     }else if(str.startsWith(QChar('#'))){
-        LuaSkillCard *new_card =  LuaSkillCard::Parse(str);
-        return new_card;
-    }if(str.contains(QChar('='))){
-        QRegExp pattern("(\\w+):(\\w*)\\[(\\w+):(.+)\\]=(.+)");
-        if(!pattern.exactMatch(str))
+        card = LuaSkillCard::Parse(str);
+    }else if(str.contains(QChar('='))){
+        // "name:skill_name[suit:number]=subcards"
+        int name_end = SkipWord(str, 0);
+        if(name_end == 0 || name_end == str.length() || str.at(name_end) != QChar(':'))
             return NULL;
 
-        QStringList texts = pattern.capturedTexts();
-        QString name = texts.at(1);
-        QString skill_name = texts.at(2);
-        QString suit_string = texts.at(3);
-        QString number_string = texts.at(4);
-        QString subcard_str = texts.at(5);
-        QStringList subcard_ids;
-        if(subcard_str != ".")
-            subcard_ids = subcard_str.split("+");
-
-        Suit suit = suit_map.value(suit_string, Card::NoSuit);
-
-        int number = 0;
-        if(number_string == "A")
-            number = 1;
-        else if(number_string == "J")
-            number = 11;
-        else if(number_string == "Q")
-            number = 12;
-        else if(number_string == "K")
-            number = 13;
-        else
-            number = number_string.toInt();
+        int skill_end = SkipWord(str, name_end + 1);
+        if(skill_end == str.length() || str.at(skill_end) != QChar('['))
+            return NULL;
+
+        int suit_end = SkipWord(str, skill_end + 1);
+        if(suit_end == skill_end + 1 || suit_end == str.length() || str.at(suit_end) != QChar(':'))
+            return NULL;
+
+        // the number is greedy, so it ends at the last "]=" followed by something
+        int number_from = suit_end + 1;
+        int pos = str.lastIndexOf("]=");
+        while(pos > number_from && pos + 2 == str.length())
+            pos = str.lastIndexOf("]=", pos - 1);
+        if(pos <= number_from)
+            return NULL;
 
-        Card *card = Sanguosha->cloneCard(name, suit, number);
-        if(card == NULL)
+        Suit suit = ParseSuit(str.midRef(skill_end + 1, suit_end - skill_end - 1));
+        int number = ParseNumber(str.midRef(number_from, pos - number_from));
+
+        Card *virtual_card = Sanguosha->cloneCard(str.left(name_end), suit, number);
+        if(virtual_card == NULL)
             return NULL;
 
-        foreach(QString subcard_id, subcard_ids)
-            card->addSubcard(subcard_id.toInt());
+        ParseSubcards(virtual_card, str, pos + 2, str.length());
 
-        card->setSkillName(skill_name);
-        return card;
+        virtual_card->setSkillName(str.mid(name_end + 1, skill_end - name_end - 1));
+        card = virtual_card;
     }else{
         bool ok;
         int card_id = str.toInt(&ok);
@@ -415,6 +499,13 @@ const Card *Card::Parse(const QString &str){
         else
             return NULL;
     }
+
+    // virtual cards belong to the room being played in this thread, if any
+    Room *room = Room::GetCurrentRoom();
+    if(room && card)
+        room->adoptVirtualCard(card);
+
+    return card;
 }
 
 Card *Card::Clone(const Card *card){
@@ -55,6 +55,7 @@ public:
 
     // constructor
     Card(Suit suit, int number, bool target_fixed = false);
+    ~Card();
 
     // property getters/setters
     QString getSuitString() const;
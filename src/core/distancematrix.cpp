@@ -0,0 +1,66 @@
+#include "distancematrix.h"
+#include "player.h"
+
+DistanceMatrix::DistanceMatrix()
+    :generation(1), checking(false)
+{
+    for(int i = 0; i < MaxSeats; i++){
+        ranges[i].generation = 0;
+        for(int j = 0; j < MaxSeats; j++)
+            distances[i][j].generation = 0;
+    }
+}
+
+void DistanceMatrix::invalidate(){
+    generation++;
+}
+
+void DistanceMatrix::setChecking(bool checking){
+    this->checking = checking;
+}
+
+static inline bool IsValidSeat(int seat, int max_seats){
+    return seat > 0 && seat <= max_seats;
+}
+
+int DistanceMatrix::distance(const Player *from, const Player *to){
+    int a = from->getSeat(), b = to->getSeat();
+    if(!IsValidSeat(a, MaxSeats) || !IsValidSeat(b, MaxSeats))
+        return from->rawDistanceTo(to);
+
+    Entry &entry = distances[a - 1][b - 1];
+    if(entry.generation != generation){
+        entry.value = from->rawDistanceTo(to);
+        entry.generation = generation;
+    }else if(checking){
+        int value = from->rawDistanceTo(to);
+        if(value != entry.value){
+            qWarning("Stale distance from %s to %s: cached %d, actual %d",
+                     qPrintable(from->objectName()), qPrintable(to->objectName()), entry.value, value);
+            entry.value = value;
+        }
+    }
+
+    return entry.value;
+}
+
+int DistanceMatrix::attackRange(const Player *player){
+    int seat = player->getSeat();
+    if(!IsValidSeat(seat, MaxSeats))
+        return player->rawAttackRange();
+
+    Entry &entry = ranges[seat - 1];
+    if(entry.generation != generation){
+        entry.value = player->rawAttackRange();
+        entry.generation = generation;
+    }else if(checking){
+        int value = player->rawAttackRange();
+        if(value != entry.value){
+            qWarning("Stale attack range of %s: cached %d, actual %d",
+                     qPrintable(player->objectName()), entry.value, value);
+            entry.value = value;
+        }
+    }
+
+    return entry.value;
+}
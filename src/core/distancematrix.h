@@ -0,0 +1,38 @@
+#ifndef DISTANCEMATRIX_H
+#define DISTANCEMATRIX_H
+
+class Player;
+
+// Caches Player::distanceTo and Player::getAttackRange for the players of one
+// room, indexed by seat. Entries carry the generation they were computed in;
+// any change that may move a distance (seat, alive, hp, equip, mark, flag,
+// pile, skill, or a hand becoming empty or not) bumps the generation and so
+// drops the whole matrix at once.
+// Lua distance skills are expected to depend on nothing else, with checking
+// on every cached value is compared against the slow path.
+class DistanceMatrix
+{
+public:
+    DistanceMatrix();
+
+    void invalidate();
+    void setChecking(bool checking);
+
+    int distance(const Player *from, const Player *to);
+    int attackRange(const Player *player);
+
+private:
+    static const int MaxSeats = 16;
+
+    struct Entry{
+        unsigned int generation;
+        int value;
+    };
+
+    Entry distances[MaxSeats][MaxSeats];
+    Entry ranges[MaxSeats];
+    unsigned int generation;
+    bool checking;
+};
+
+#endif // DISTANCEMATRIX_H
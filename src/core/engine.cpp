@@ -10,6 +10,7 @@
 #include "protocol.h"
 #include "jsonutils.h"
 #include "structs.h"
+#include "atom.h"
 
 #include <QFile>
 #include <QTextStream>
@@ -20,8 +21,6 @@
 
 Engine *Sanguosha = NULL;
 
-bool Engine::AI_FREE = true;
-
 void Engine::addPackage(const QString &name){
     Package *pack = PackageAdder::packages()[name];
     if(pack)
@@ -109,6 +108,9 @@ void Engine::addTranslationEntry(const char *key, const char *value){
 Engine::~Engine(){
     lua_close(lua);
 
+    qDeleteAll(pattern_cache);
+    qDeleteAll(retired_patterns);
+
 #ifdef AUDIO_SUPPORT
 
     Audio::quit();
@@ -139,6 +141,7 @@ void Engine::addSkills(const QList<const Skill *> &all_skills){
             QMessageBox::warning(NULL, "", tr("Duplicated skill : %1").arg(skill->objectName()));
 
         skills.insert(skill->objectName(), skill);
+        skill_atoms.insert(AtomTable::Intern(skill->objectName()), skill);
 
         if(skill->inherits("ProhibitSkill"))
             prohibit_skills << qobject_cast<const ProhibitSkill *>(skill);
@@ -227,11 +230,36 @@ int Engine::getRoleIndex() const{
         return 1;
 }
 
+// compiled patterns are only held for a short while by their users,
+// so when the cache is full, the current generation is retired and the
+// previous one, which nobody has asked for since, is freed; users keeping
+// a pattern for longer, such as ResponseSkill, keep a copy of their own
+static const int PatternCacheSize = 1024;
+
 const CardPattern *Engine::getPattern(const QString &name) const{
     const CardPattern * ptn = patterns.value(name, NULL);
     if(ptn)return ptn;
 
-    return new ExpPattern(name);
+    return getExpPattern(name);
+}
+
+const CardPattern *Engine::getExpPattern(const QString &exp) const{
+    QMutexLocker locker(&pattern_mutex);
+    const CardPattern *ptn = pattern_cache.value(exp, NULL);
+    if(ptn)return ptn;
+
+    ptn = retired_patterns.take(exp);
+    if(ptn == NULL)
+        ptn = new ExpPattern(exp);
+
+    if(pattern_cache.size() >= PatternCacheSize){
+        qDeleteAll(retired_patterns);
+        retired_patterns = pattern_cache;
+        pattern_cache.clear();
+    }
+
+    pattern_cache.insert(exp, ptn);
+    return ptn;
 }
 
 QList<const Skill *> Engine::getRelatedSkills(const QString &skill_name) const{
@@ -393,6 +421,8 @@ QString Engine::getSetupString() const{
         flags.append("M");
     if(Config.EnableSnatchHero)
         flags.append("Q");
+    if(Config.EnableBinaryPacket)
+        flags.append("P");
 
     if(Config.MaxHpScheme == 1)
         flags.append("1");
@@ -734,6 +764,10 @@ const Skill *Engine::getSkill(const QString &skill_name) const{
     return skills.value(skill_name, NULL);
 }
 
+const Skill *Engine::getSkill(int skill_atom) const{
+    return skill_atoms.value(skill_atom, NULL);
+}
+
 QStringList Engine::getSkillNames() const{
     return skills.keys();
 }
@@ -789,10 +823,3 @@ int Engine::correctMaxCards(const Player *target) const{
     return extra;
 }
 
-bool Engine::getAIState(){
-    return AI_FREE;
-}
-
-void Engine::setAIState(bool state){
-    AI_FREE=state;
-}
@@ -12,6 +12,7 @@
 #include <QHash>
 #include <QStringList>
 #include <QMetaObject>
+#include <QMutex>
 
 class AI;
 class Scenario;
@@ -53,6 +54,7 @@ public:
     int getRoleIndex() const;
 
     const CardPattern *getPattern(const QString &name) const;
+    const CardPattern *getExpPattern(const QString &exp) const;
     QList<const Skill *> getRelatedSkills(const QString &skill_name) const;
 
     QStringList getScenarioNames() const;
@@ -65,6 +67,7 @@ public:
     const General *getGeneral(const QString &name) const;
     int getGeneralCount(bool include_banned = false) const;
     const Skill *getSkill(const QString &skill_name) const;
+    const Skill *getSkill(int skill_atom) const;
     QStringList getSkillNames() const;
     const TriggerSkill *getTriggerSkill(const QString &skill_name) const;
     const ViewAsSkill *getViewAsSkill(const QString &skill_name) const;
@@ -92,17 +95,19 @@ public:
     const ProhibitSkill *isProhibited(const Player *from, const Player *to, const Card *card) const;
     int correctDistance(const Player *from, const Player *to) const;
     int correctMaxCards(const Player *target) const;
-    //
-    void setAIState(bool state);
-    bool getAIState();
 
 private:
     QHash<QString, QString> translations;
     QHash<QString, const General *> generals, hidden_generals;
     QHash<QString, const QMetaObject *> metaobjects;
     QHash<QString, const Skill *> skills;
+    QHash<int, const Skill *> skill_atoms;
     QMap<QString, QString> modes;
     QMap<QString, const CardPattern *> patterns;
+
+    // expression patterns compiled by getPattern, see PatternCacheSize
+    mutable QHash<QString, const CardPattern *> pattern_cache, retired_patterns;
+    mutable QMutex pattern_mutex;
     QMultiMap<QString, QString> related_skills;
 
     // 3kingdoms
@@ -120,8 +125,6 @@ private:
     QSet<QString> ban_package;
 
     lua_State *lua;
-    //
-    static bool AI_FREE;
 };
 
 extern Engine *Sanguosha;
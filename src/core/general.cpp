@@ -4,6 +4,7 @@
 #include "package.h"
 #include "client.h"
 #include "settings.h"
+#include "atom.h"
 
 #include <QSize>
 #include <QFile>
@@ -74,16 +75,29 @@ QString General::getPixmapPath(const QString &category) const{
 void General::addSkill(Skill *skill){
     skill->setParent(this);
     skill_set << skill->objectName();
+    skill_atoms << AtomTable::Intern(skill->objectName());
 }
 
 void General::addSkill(const QString &skill_name){
     extra_set << skill_name;
+    skill_atoms << AtomTable::Intern(skill_name);
 }
 
 bool General::hasSkill(const QString &skill_name) const{
     return skill_set.contains(skill_name) || extra_set.contains(skill_name);
 }
 
+bool General::hasSkill(int skill_atom) const{
+    return skill_atoms.contains(skill_atom);
+}
+
+QSet<QString> General::getSkillNames() const{
+    if(extra_set.isEmpty())
+        return skill_set;
+
+    return skill_set + extra_set;
+}
+
 QList<const Skill *> General::getVisibleSkillList() const{
     QList<const Skill *> skills;
     foreach(const Skill *skill, findChildren<const Skill *>()){
@@ -43,6 +43,8 @@ public:
     void addSkill(Skill* skill);
     void addSkill(const QString &skill_name);
     bool hasSkill(const QString &skill_name) const;
+    bool hasSkill(int skill_atom) const;
+    QSet<QString> getSkillNames() const;
     QList<const Skill *> getVisibleSkillList() const;
     QSet<const Skill *> getVisibleSkills() const;
     QSet<const TriggerSkill *> getTriggerSkills() const;
@@ -68,6 +70,7 @@ private:
     bool lord;
     QSet<QString> skill_set;
     QSet<QString> extra_set;
+    QSet<int> skill_atoms;
     QStringList related_skills;
     bool hidden;
     bool never_shown;
@@ -18,6 +18,11 @@ int LuaTriggerSkill::getPriority() const{
     return priority;
 }
 
+bool LuaTriggerSkill::isGlobal() const{
+    // a custom can_trigger may accept any player
+    return can_trigger != 0;
+}
+
 LuaProhibitSkill::LuaProhibitSkill(const char *name)
     :ProhibitSkill(name), is_prohibited(0)
 {
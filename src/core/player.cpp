@@ -4,13 +4,32 @@
 #include "client.h"
 #include "standard.h"
 #include "settings.h"
+#include "atom.h"
+#include "distancematrix.h"
+
+// atoms looked up by the hot paths below
+static const int TianyiSuccessFlag = AtomTable::Intern("tianyi_success");
+static const int JiangchiInvokeFlag = AtomTable::Intern("jiangchi_invoke");
+static const int SwordMark = AtomTable::Intern("@sword");
+static const int DuanchangMark = AtomTable::Intern("@duanchang");
+static const int HuoshuiMark = AtomTable::Intern("@huoshui");
+static const int Qingcheng1Mark = AtomTable::Intern("@qingcheng1");
+static const int Qingcheng2Mark = AtomTable::Intern("@qingcheng2");
+static const int Qingcheng3Mark = AtomTable::Intern("@qingcheng3");
+static const int Qingcheng4Mark = AtomTable::Intern("@qingcheng4");
+static const int ZhengfengSkill = AtomTable::Intern("zhengfeng");
+static const int WeidiSkill = AtomTable::Intern("weidi");
+static const int WuqianFlag = AtomTable::Intern("wuqian");
+static const int QinggangMark = AtomTable::Intern("qinggang");
+static const int KongchengSkill = AtomTable::Intern("kongcheng");
+static const int PaoxiaoSkill = AtomTable::Intern("paoxiao");
 
 Player::Player(QObject *parent)
     :QObject(parent), owner(false), ready(false), general(NULL), general2(NULL),
-    hp(-1), max_hp(-1), state("online"), seat(0), alive(true),
+    hp(-1), max_hp(-1), role_enum(Lord), state("online"), seat(0), alive(true),
     phase(NotActive),
     weapon(NULL), armor(NULL), defensive_horse(NULL), offensive_horse(NULL),
-    face_up(true), chained(false), player_statistics(new StatisticsStruct())
+    face_up(true), chained(false), distance_matrix(NULL), player_statistics(new StatisticsStruct())
 {
 }
 
@@ -47,6 +66,7 @@ void Player::setReady(bool ready){
 void Player::setHp(int hp){
     if(hp <= max_hp && this->hp != hp){
         this->hp = hp;
+        invalidateDistances();
         emit state_changed();
     }
 }
@@ -67,6 +87,7 @@ void Player::setMaxHp(int max_hp){
     if(hp > max_hp)
         hp = max_hp;
 
+    invalidateDistances();
     emit state_changed();
 }
 
@@ -94,6 +115,7 @@ int Player::getSeat() const{
 
 void Player::setSeat(int seat){
     this->seat = seat;
+    invalidateDistances();
 }
 
 bool Player::isAlive() const{
@@ -106,12 +128,13 @@ bool Player::isDead() const{
 
 void Player::setAlive(bool alive){
     this->alive = alive;
+    invalidateDistances();
 }
 
 QString Player::getFlags() const{
     QStringList flags_list;
-    foreach(QString flag, flags)
-        flags_list << flag;
+    foreach(int flag, flags)
+        flags_list << AtomTable::Name(flag);
 
     return flags_list.join("+");
 }
@@ -121,27 +144,41 @@ void Player::setFlags(const QString &flag){
     if(flag.startsWith(unset_symbol)){
         QString copy = flag;
         copy.remove(unset_symbol);
-        flags.remove(copy);
+        flags.remove(AtomTable::Find(copy));
     }else{
-        flags.insert(flag);
+        flags.insert(AtomTable::Intern(flag));
     }
+
+    invalidateDistances();
 }
 
 bool Player::hasFlag(const QString &flag) const{
-    return flags.contains(flag);
+    return flags.contains(AtomTable::Find(flag));
+}
+
+bool Player::hasFlag(int flag_atom) const{
+    return flags.contains(flag_atom);
 }
 
 void Player::clearFlags(){
     flags.clear();
+    invalidateDistances();
 }
 
 int Player::getAttackRange() const{
-    if(hasFlag("tianyi_success") || hasFlag("jiangchi_invoke"))
+    if(distance_matrix)
+        return distance_matrix->attackRange(this);
+
+    return rawAttackRange();
+}
+
+int Player::rawAttackRange() const{
+    if(hasFlag(TianyiSuccessFlag) || hasFlag(JiangchiInvokeFlag))
         return 1000;
-    int extra = getMark("@sword") > 0 ? getMark("@sword") : 0;
+    int extra = qMax(getMark(SwordMark), 0);
     if(weapon)
         return weapon->getRange() + extra;
-    else if(hasSkill("zhengfeng"))
+    else if(hasSkill(ZhengfengSkill))
         return hp + extra;
     else
         return 1 + extra;
@@ -156,6 +193,25 @@ void Player::setFixedDistance(const Player *player, int distance){
         fixed_distance.remove(player);
     else
         fixed_distance.insert(player, distance);
+
+    invalidateDistances();
+}
+
+void Player::setDistanceMatrix(DistanceMatrix *matrix){
+    distance_matrix = matrix;
+}
+
+void Player::invalidateDistances(){
+    if(distance_matrix)
+        distance_matrix->invalidate();
+}
+
+int Player::rawDistanceTo(const Player *other) const{
+    int right = qAbs(seat - other->seat);
+    int left = aliveCount() - right;
+    int distance = qMin(left, right);
+
+    return distance + Sanguosha->correctDistance(this, other);
 }
 
 int Player::distanceTo(const Player *other, int fix) const{
@@ -165,11 +221,7 @@ int Player::distanceTo(const Player *other, int fix) const{
     if(fixed_distance.contains(other))
         return fixed_distance.value(other);
 
-    int right = qAbs(seat - other->seat);
-    int left = aliveCount() - right;
-    int distance = qMin(left, right);
-
-    distance += Sanguosha->correctDistance(this, other);
+    int distance = distance_matrix ? distance_matrix->distance(this, other) : rawDistanceTo(other);
     distance += fix;
 
     // keep the distance >=1
@@ -182,6 +234,7 @@ int Player::distanceTo(const Player *other, int fix) const{
 void Player::setGeneral(const General *new_general){
     if(this->general != new_general){
         this->general = new_general;
+        invalidateDistances();
 
         if(new_general && kingdom.isEmpty())
             setKingdom(new_general->getKingdom());
@@ -206,6 +259,7 @@ void Player::setGeneral2Name(const QString &general_name){
     const General *new_general = Sanguosha->getGeneral(general_name);
     if(general2 != new_general){
         general2 = new_general;
+        invalidateDistances();
 
         emit general2_changed();
     }
@@ -236,6 +290,17 @@ void Player::setState(const QString &state){
 void Player::setRole(const QString &role){
     if(this->role != role){
         this->role = role;
+
+        // looked up on every AI relation query, so it is resolved here once
+        if(role == "loyalist")
+            role_enum = Loyalist;
+        else if(role == "rebel")
+            role_enum = Rebel;
+        else if(role == "renegade")
+            role_enum = Renegade;
+        else
+            role_enum = Lord;
+
         emit role_changed(role);
     }
 }
@@ -245,15 +310,7 @@ QString Player::getRole() const{
 }
 
 Player::Role Player::getRoleEnum() const{
-    static QMap<QString, Role> role_map;
-    if(role_map.isEmpty()){
-        role_map.insert("lord", Lord);
-        role_map.insert("loyalist", Loyalist);
-        role_map.insert("rebel", Rebel);
-        role_map.insert("renegade", Renegade);
-    }
-
-    return role_map.value(role);
+    return role_enum;
 }
 
 const General *Player::getAvatarGeneral() const{
@@ -275,44 +332,61 @@ bool Player::isLord() const{
 }
 
 bool Player::SkillCheck(const QString &skill_name) const{
-    const Skill *skill = Sanguosha->getSkill(skill_name);
+    return SkillCheck(AtomTable::Find(skill_name));
+}
+
+bool Player::SkillCheck(int skill_atom) const{
+    const Skill *skill = Sanguosha->getSkill(skill_atom);
     if(skill == NULL)
         return false;
 
-    if(skill->inherits("TriggerSkill"))
+    if(qobject_cast<const TriggerSkill *>(skill))
         return !loseTriggerSkills();
-    else if(skill->inherits("ViewAsSkill"))
+    else if(qobject_cast<const ViewAsSkill *>(skill))
         return !loseViewAsSkills();
-    else if(skill->inherits("ProhibitSkill"))
+    else if(qobject_cast<const ProhibitSkill *>(skill))
         return !loseProhibitSkills();
-    else if(skill->inherits("DistanceSkill"))
+    else if(qobject_cast<const DistanceSkill *>(skill))
         return !loseDistanceSkills();
     else
         return !loseOtherSkills();
 }
 
 bool Player::hasSkill(const QString &skill_name, bool includelost) const{
-    if(hasInnateSkill(skill_name) || acquired_skills.contains(skill_name))
-        return SkillCheck(skill_name) || includelost;
+    int skill_atom = AtomTable::Find(skill_name);
+    if(skill_atom == -1)
+        return false;
+
+    return hasSkill(skill_atom, includelost);
+}
+
+bool Player::hasSkill(int skill_atom, bool includelost) const{
+    if(hasInnateSkill(skill_atom) || acquired_atoms.contains(skill_atom))
+        return SkillCheck(skill_atom) || includelost;
     else
         return false;
 }
 
 bool Player::hasInnateSkill(const QString &skill_name) const{
-    if(general && general->hasSkill(skill_name))
+    return hasInnateSkill(AtomTable::Find(skill_name));
+}
+
+bool Player::hasInnateSkill(int skill_atom) const{
+    if(general && general->hasSkill(skill_atom))
         return true;
 
-    if(general2 && general2->hasSkill(skill_name))
+    if(general2 && general2->hasSkill(skill_atom))
         return true;
 
     return false;
 }
 
 bool Player::hasLordSkill(const QString &skill_name, bool includelost) const{
-    if(!SkillCheck(skill_name) && !includelost)
+    int skill_atom = AtomTable::Find(skill_name);
+    if(!SkillCheck(skill_atom) && !includelost)
         return false;
 
-    if(acquired_skills.contains(skill_name))
+    if(acquired_atoms.contains(skill_atom))
         return true;
 
     QString mode = getGameMode();
@@ -320,9 +394,9 @@ bool Player::hasLordSkill(const QString &skill_name, bool includelost) const{
         return false;
 
     if(isLord() || ServerInfo.EnableHegemony || mode == "03_3kingdoms")
-        return hasInnateSkill(skill_name);
+        return hasInnateSkill(skill_atom);
 
-    if(hasSkill("weidi")){
+    if(hasSkill(WeidiSkill)){
         foreach(const Player *player, getSiblings()){
             if(player->isLord())
                 return player->hasLordSkill(skill_name);
@@ -333,35 +407,38 @@ bool Player::hasLordSkill(const QString &skill_name, bool includelost) const{
 }
 
 bool Player::loseTriggerSkills() const{
-    return (getMark("@duanchang") + getMark("@huoshui") + getMark("@qingcheng1")) > 0;
+    return (getMark(DuanchangMark) + getMark(HuoshuiMark) + getMark(Qingcheng1Mark)) > 0;
 }
 
 bool Player::loseViewAsSkills() const{
-    return (getMark("@duanchang") + getMark("@huoshui") + getMark("@qingcheng2")) > 0;
+    return (getMark(DuanchangMark) + getMark(HuoshuiMark) + getMark(Qingcheng2Mark)) > 0;
 }
 
 bool Player::loseProhibitSkills() const{
-    return (getMark("@duanchang") + getMark("@huoshui") + getMark("@qingcheng3")) > 0;
+    return (getMark(DuanchangMark) + getMark(HuoshuiMark) + getMark(Qingcheng3Mark)) > 0;
 }
 
 bool Player::loseDistanceSkills() const{
-    return (getMark("@duanchang") + getMark("@huoshui") + getMark("@qingcheng4")) > 0;
+    return (getMark(DuanchangMark) + getMark(HuoshuiMark) + getMark(Qingcheng4Mark)) > 0;
 }
 
 bool Player::loseOtherSkills() const{
-    return getMark("@duanchang") > 0;
+    return getMark(DuanchangMark) > 0;
 }
 
 void Player::addSkill(const QString &skill_name){
     additional_skills.insert(skill_name);
+    invalidateDistances();
 }
 
 void Player::deleteSkill(const QString &skill_name){
     additional_skills.remove(skill_name);
+    invalidateDistances();
 }
 
 void Player::removeAdditionalSkills(){
     additional_skills.clear();
+    invalidateDistances();
 }
 
 QSet<QString> Player::getAdditionalSkills() const{
@@ -370,14 +447,20 @@ QSet<QString> Player::getAdditionalSkills() const{
 
 void Player::acquireSkill(const QString &skill_name){
     acquired_skills.insert(skill_name);
+    acquired_atoms.insert(AtomTable::Intern(skill_name));
+    invalidateDistances();
 }
 
 void Player::loseSkill(const QString &skill_name){
     acquired_skills.remove(skill_name);
+    acquired_atoms.remove(AtomTable::Find(skill_name));
+    invalidateDistances();
 }
 
 void Player::loseAllSkills(){
     acquired_skills.clear();
+    acquired_atoms.clear();
+    invalidateDistances();
 }
 
 QString Player::getPhaseString() const{
@@ -418,6 +501,8 @@ void Player::setEquip(const EquipCard *card){
     case EquipCard::DefensiveHorseLocation: defensive_horse = qobject_cast<const Horse*>(card); break;
     case EquipCard::OffensiveHorseLocation: offensive_horse = qobject_cast<const Horse*>(card); break;
     }
+
+    invalidateDistances();
 }
 
 void Player::removeEquip(const EquipCard *equip){
@@ -427,6 +512,8 @@ void Player::removeEquip(const EquipCard *equip){
     case EquipCard::DefensiveHorseLocation: defensive_horse = NULL; break;
     case EquipCard::OffensiveHorseLocation:offensive_horse = NULL; break;
     }
+
+    invalidateDistances();
 }
 
 bool Player::hasEquip(const Card *card) const{
@@ -485,7 +572,7 @@ bool Player::hasWeapon(const QString &weapon_name) const{
 }
 
 bool Player::hasArmorEffect(const QString &armor_name) const{
-    return armor && !hasFlag("wuqian") && getMark("qinggang") == 0 && armor->objectName() == armor_name;
+    return armor && !hasFlag(WuqianFlag) && getMark(QinggangMark) == 0 && armor->objectName() == armor_name;
 }
 
 QList<const Card *> Player::getJudgingArea() const{
@@ -605,30 +692,36 @@ void Player::setChained(bool chained){
 }
 
 void Player::addMark(const QString &mark){
-    int value = marks.value(mark, 0);
+    int value = getMark(mark);
     value++;
     setMark(mark, value);
 }
 
 void Player::removeMark(const QString &mark){
-    int value = marks.value(mark, 0);
+    int value = getMark(mark);
     value--;
     value = qMax(0, value);
     setMark(mark, value);
 }
 
 void Player::setMark(const QString &mark, int value){
-    if(marks[mark] != value){
-        marks[mark] = value;
+    int mark_atom = AtomTable::Intern(mark);
+    if(marks[mark_atom] != value){
+        marks[mark_atom] = value;
+        invalidateDistances();
     }
 }
 
 int Player::getMark(const QString &mark) const{
-    return marks.value(mark, 0);
+    return marks.value(AtomTable::Find(mark), 0);
+}
+
+int Player::getMark(int mark_atom) const{
+    return marks.value(mark_atom, 0);
 }
 
 bool Player::canSlash(const Player *other, bool distance_limit, int distance_fix) const{
-    if(other->hasSkill("kongcheng") && other->isKongcheng())
+    if(other->hasSkill(KongchengSkill) && other->isKongcheng())
         return false;
 
     if(other == this)
@@ -752,14 +845,14 @@ bool Player::isProhibited(const Player *to, const Card *card) const{
 }
 
 bool Player::canSlashWithoutCrossbow() const{
-    if(hasSkill("paoxiao"))
+    if(hasSkill(PaoxiaoSkill))
         return true;
 
     int slash_count = getSlashCount();
     int valid_slash_count = 1;
-    if(hasFlag("tianyi_success"))
+    if(hasFlag(TianyiSuccessFlag))
         valid_slash_count++;
-    if(hasFlag("jiangchi_invoke"))
+    if(hasFlag(JiangchiInvokeFlag))
         valid_slash_count++;
     return slash_count < valid_slash_count;
 }
@@ -785,23 +878,23 @@ bool Player::isJilei(const Card *card) const{
         foreach(int card_id, card->getSubcards()){
             const Card *c = Sanguosha->getCard(card_id);
             foreach(QString pattern, jilei_set.toList()){
-                ExpPattern p(pattern);
-                if(p.match(this,c) && !hasEquip(c)) return true;
+                const CardPattern *p = Sanguosha->getExpPattern(pattern);
+                if(p->match(this,c) && !hasEquip(c)) return true;
             }
         }
     }
     else{
         if(card->getSubcards().isEmpty())
             foreach(QString pattern, jilei_set.toList()){
-                ExpPattern p(pattern);
-                if(p.match(this,card)) return true;
+                const CardPattern *p = Sanguosha->getExpPattern(pattern);
+                if(p->match(this,card)) return true;
             }
         else{
             foreach(int card_id, card->getSubcards()){
                 const Card *c = Sanguosha->getCard(card_id);
                 foreach(QString pattern, jilei_set.toList()){
-                    ExpPattern p(pattern);
-                    if(p.match(this,card) && !hasEquip(c)) return true;
+                    const CardPattern *p = Sanguosha->getExpPattern(pattern);
+                    if(p->match(this,card) && !hasEquip(c)) return true;
                 }
             }
         }
@@ -857,10 +950,11 @@ void Player::copyFrom(Player* p)
     Player *b = this;
     Player *a = p;
 
-    b->marks            = QMap<QString, int> (a->marks);
+    b->marks            = QMap<int, int> (a->marks);
     b->piles            = QMap<QString, QList<int> > (a->piles);
     b->acquired_skills  = QSet<QString> (a->acquired_skills);
-    b->flags            = QSet<QString> (a->flags);
+    b->acquired_atoms   = QSet<int> (a->acquired_atoms);
+    b->flags            = QSet<int> (a->flags);
     b->history          = QHash<QString, int> (a->history);
 
     b->hp               = a->hp;
@@ -13,6 +13,7 @@ class Armor;
 class Horse;
 class DelayedTrick;
 class DistanceSkill;
+class DistanceMatrix;
 class TriggerSkill;
 
 class Player : public QObject
@@ -113,6 +114,7 @@ public:
     QString getFlags() const;
     virtual void setFlags(const QString &flag);
     bool hasFlag(const QString &flag) const;
+    bool hasFlag(int flag_atom) const;
     void clearFlags();
 
     bool faceUp() const;
@@ -121,6 +123,9 @@ public:
     virtual int aliveCount() const = 0;
     void setFixedDistance(const Player *player, int distance);
     int distanceTo(const Player *other, int fix = 0) const;
+
+    // server players share their room's matrix, client players have none
+    void setDistanceMatrix(DistanceMatrix *matrix);
     const General *getAvatarGeneral() const;
     const General *getGeneral() const;
 
@@ -135,8 +140,11 @@ public:
     void loseSkill(const QString &skill_name);
     void loseAllSkills();
     bool hasSkill(const QString &skill_name, bool includelost = false) const;
+    bool hasSkill(int skill_atom, bool includelost = false) const;
     bool SkillCheck(const QString &skill_name) const;
+    bool SkillCheck(int skill_atom) const;
     bool hasInnateSkill(const QString &skill_name) const;
+    bool hasInnateSkill(int skill_atom) const;
     bool hasLordSkill(const QString &skill_name, bool includelost = false) const;
     bool loseTriggerSkills() const;
     bool loseViewAsSkills() const;
@@ -179,6 +187,7 @@ public:
     void removeMark(const QString &mark);
     virtual void setMark(const QString &mark, int value);
     int getMark(const QString &mark) const;
+    int getMark(int mark_atom) const;
 
     void setChained(bool chained);
     bool isChained() const;
@@ -222,11 +231,18 @@ public:
     QVariantMap tag;
 
 protected:
-    QMap<QString, int> marks;
+    friend class PlayerState;
+    friend class DistanceMatrix;
+
+    void invalidateDistances();
+
+    // marks and flags are keyed by the atoms of their names, see AtomTable
+    QMap<int, int> marks;
     QMap<QString, QList<int> > piles;
     QSet<QString> acquired_skills;
+    QSet<int> acquired_atoms;
     QSet<QString> additional_skills;
-    QSet<QString> flags;
+    QSet<int> flags;
     QHash<QString, int> history;
 
 private:
@@ -237,6 +253,7 @@ private:
     int hp, max_hp;
     QString kingdom;
     QString role;
+    Role role_enum;
     QString state;
     int seat;
     bool alive;
@@ -250,6 +267,11 @@ private:
     QList<const Card *> judging_area;
     QList<const DelayedTrick *> delayed_tricks;
     QHash<const Player *, int> fixed_distance;
+    DistanceMatrix *distance_matrix;
+
+    // the uncached computations behind distanceTo and getAttackRange
+    int rawDistanceTo(const Player *other) const;
+    int rawAttackRange() const;
 
     QSet<QString> jilei_set;
     QSet<QString> lock_card;
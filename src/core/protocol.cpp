@@ -2,6 +2,7 @@
 #include <json/json.h>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
 
 using namespace std;
 using namespace QSanProtocol;
@@ -118,3 +119,214 @@ string QSanProtocol::QSanGeneralPacket::toString() const
     }
     return msg;
 }
+
+namespace
+{
+    enum BinaryTag
+    {
+        S_TAG_NULL,
+        S_TAG_FALSE,
+        S_TAG_TRUE,
+        S_TAG_INT,
+        S_TAG_UINT,
+        S_TAG_REAL,
+        S_TAG_STRING,
+        S_TAG_ARRAY,
+        S_TAG_OBJECT
+    };
+
+    const int S_MAX_BINARY_DEPTH = 32;
+
+    void writeVarUInt(string &out, Json::LargestUInt val)
+    {
+        while (val >= 0x80)
+        {
+            out += (char)((val & 0x7F) | 0x80);
+            val >>= 7;
+        }
+        out += (char)val;
+    }
+
+    void writeString(string &out, const string &val)
+    {
+        writeVarUInt(out, val.length());
+        out += val;
+    }
+
+    void writeValue(string &out, const Json::Value &val)
+    {
+        switch (val.type())
+        {
+        case Json::booleanValue:
+            out += (char)(val.asBool() ? S_TAG_TRUE : S_TAG_FALSE);
+            break;
+        case Json::intValue:
+        {
+            // zigzag encoding keeps small negative numbers short
+            Json::LargestInt i = val.asLargestInt();
+            out += (char)S_TAG_INT;
+            writeVarUInt(out, ((Json::LargestUInt)i << 1) ^ (Json::LargestUInt)(i >> 63));
+            break;
+        }
+        case Json::uintValue:
+            out += (char)S_TAG_UINT;
+            writeVarUInt(out, val.asLargestUInt());
+            break;
+        case Json::realValue:
+        {
+            double d = val.asDouble();
+            out += (char)S_TAG_REAL;
+            out.append((const char *)&d, sizeof(double));
+            break;
+        }
+        case Json::stringValue:
+            out += (char)S_TAG_STRING;
+            writeString(out, val.asString());
+            break;
+        case Json::arrayValue:
+            out += (char)S_TAG_ARRAY;
+            writeVarUInt(out, val.size());
+            for (unsigned int i = 0; i < val.size(); i++)
+                writeValue(out, val[i]);
+            break;
+        case Json::objectValue:
+        {
+            Json::Value::Members members = val.getMemberNames();
+            out += (char)S_TAG_OBJECT;
+            writeVarUInt(out, members.size());
+            for (Json::Value::Members::const_iterator it = members.begin(); it != members.end(); ++it)
+            {
+                writeString(out, *it);
+                writeValue(out, val[*it]);
+            }
+            break;
+        }
+        default:
+            out += (char)S_TAG_NULL;
+            break;
+        }
+    }
+
+    bool readVarUInt(const string &in, size_t &pos, Json::LargestUInt &val)
+    {
+        val = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= in.length()) return false;
+            unsigned char byte = (unsigned char)in[pos++];
+            val |= (Json::LargestUInt)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool readString(const string &in, size_t &pos, string &val)
+    {
+        Json::LargestUInt length;
+        if (!readVarUInt(in, pos, length) || length > in.length() - pos)
+            return false;
+        val = in.substr(pos, (size_t)length);
+        pos += (size_t)length;
+        return true;
+    }
+
+    bool readValue(const string &in, size_t &pos, Json::Value &val, int depth)
+    {
+        if (pos >= in.length() || depth > S_MAX_BINARY_DEPTH) return false;
+        Json::LargestUInt num;
+        switch ((unsigned char)in[pos++])
+        {
+        case S_TAG_NULL:
+            val = Json::Value(Json::nullValue);
+            return true;
+        case S_TAG_FALSE:
+            val = false;
+            return true;
+        case S_TAG_TRUE:
+            val = true;
+            return true;
+        case S_TAG_INT:
+            if (!readVarUInt(in, pos, num)) return false;
+            val = (Json::LargestInt)(num >> 1) ^ -(Json::LargestInt)(num & 1);
+            return true;
+        case S_TAG_UINT:
+            if (!readVarUInt(in, pos, num)) return false;
+            val = num;
+            return true;
+        case S_TAG_REAL:
+        {
+            double d;
+            if (in.length() - pos < sizeof(double)) return false;
+            memcpy(&d, in.data() + pos, sizeof(double));
+            pos += sizeof(double);
+            val = d;
+            return true;
+        }
+        case S_TAG_STRING:
+        {
+            string s;
+            if (!readString(in, pos, s)) return false;
+            val = s;
+            return true;
+        }
+        case S_TAG_ARRAY:
+            // every element takes at least one byte, so a count beyond the input is corrupt
+            if (!readVarUInt(in, pos, num) || num > in.length() - pos) return false;
+            val = Json::Value(Json::arrayValue);
+            for (unsigned int i = 0; i < num; i++)
+            {
+                if (!readValue(in, pos, val[i], depth + 1))
+                    return false;
+            }
+            return true;
+        case S_TAG_OBJECT:
+            if (!readVarUInt(in, pos, num) || num > in.length() - pos) return false;
+            val = Json::Value(Json::objectValue);
+            for (unsigned int i = 0; i < num; i++)
+            {
+                string key;
+                if (!readString(in, pos, key) || !readValue(in, pos, val[key], depth + 1))
+                    return false;
+            }
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
+bool QSanProtocol::QSanGeneralPacket::parseBinary(const string &s)
+{
+    size_t pos = 0;
+    Json::LargestUInt globalSerial, localSerial, packetType, command;
+    if (!readVarUInt(s, pos, globalSerial) || !readVarUInt(s, pos, localSerial)
+        || !readVarUInt(s, pos, packetType) || !readVarUInt(s, pos, command))
+    {
+        return false;
+    }
+
+    Json::Value body(Json::nullValue);
+    if (pos < s.length() && (!readValue(s, pos, body, 0) || pos != s.length()))
+        return false;
+
+    m_globalSerial = (unsigned int)globalSerial;
+    m_localSerial = (unsigned int)localSerial;
+    m_packetType = (PacketType)packetType;
+    m_command = (CommandType)command;
+    if (body != Json::nullValue)
+        parseBody(body);
+    return true;
+}
+
+string QSanProtocol::QSanGeneralPacket::toBinary() const
+{
+    string msg;
+    writeVarUInt(msg, m_globalSerial);
+    writeVarUInt(msg, m_localSerial);
+    writeVarUInt(msg, m_packetType);
+    writeVarUInt(msg, m_command);
+    const Json::Value &body = constructBody();
+    if (body != Json::nullValue)
+        writeValue(msg, body);
+    return msg;
+}
@@ -154,6 +154,8 @@ namespace QSanProtocol
     public:
         virtual bool parse(const std::string&) = 0;
         virtual std::string toString() const = 0;
+        virtual bool parseBinary(const std::string&) = 0;
+        virtual std::string toBinary() const = 0;
         virtual PacketType getPacketType() const = 0;
         virtual CommandType getCommandType() const = 0;        
     };
@@ -178,6 +180,9 @@ namespace QSanProtocol
         inline const Json::Value& getMessageBody() const {return m_msgBody;}
         virtual bool parse(const std::string&);
         virtual std::string toString() const;
+        //binary format: varint serials, packet type and command, then a tagged body (if any)
+        virtual bool parseBinary(const std::string&);
+        virtual std::string toBinary() const;
         inline virtual PacketType getPacketType() const { return m_packetType; }
         inline virtual CommandType getCommandType() const { return m_command; }
     protected:
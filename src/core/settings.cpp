@@ -89,9 +89,11 @@ void Settings::init(){
     EnableHegemony = value("EnableHegemony", false).toBool();
     MaxHpScheme = value("MaxHpScheme", 0).toInt();
     AnnounceIP = value("AnnounceIP", false).toBool();
+    EnableBinaryPacket = value("EnableBinaryPacket", true).toBool();
     Address = value("Address", QString()).toString();
     EnableAI = value("EnableAI", true).toBool();
     AIDelay = value("AIDelay", 1000).toInt();
+    AIDecisionBudget = value("AIDecisionBudget", 3000).toInt();
     ServerPort = value("ServerPort", 9527u).toUInt();
 
 #ifdef Q_OS_WIN32
@@ -138,6 +140,13 @@ void Settings::init(){
     NodePort = value("NodePort", 9527u).toUInt();
 
     GodSelectLimited = value("GodSelectLimited", 98).toUInt();
+    LuaStatePoolSize = value("LuaStatePoolSize", 2).toInt();
+    RoomWorkers = value("RoomWorkers", -1).toInt();
+    RoomStackSize = value("RoomStackSize", 0).toInt();
+    MetricsPort = value("MetricsPort", 0u).toUInt();
+    MetricsInterval = value("MetricsInterval", 0).toInt();
+    MetricsFile = value("MetricsFile", "metrics.json").toString();
+    DistanceCacheCheck = value("DistanceCacheCheck", false).toBool();
 
     QStringList roles_ban, kof_ban, basara_ban, hegemony_ban, pairs_ban, threekingdoms_ban;
 
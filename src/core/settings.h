@@ -42,9 +42,11 @@ public:
     bool EnableHegemony;
     int MaxHpScheme;
     bool AnnounceIP;
+    bool EnableBinaryPacket;
     QString Address;
     bool EnableAI;
     int AIDelay;
+    int AIDecisionBudget;
     ushort ServerPort;
 
     // client side
@@ -97,6 +99,13 @@ public:
     ushort NodePort;
     QString NodeAddress;
     int GodSelectLimited;
+    int LuaStatePoolSize;
+    int RoomWorkers;
+    int RoomStackSize;
+    ushort MetricsPort;
+    int MetricsInterval;
+    QString MetricsFile;
+    bool DistanceCacheCheck;
 };
 
 extern Settings Config;
@@ -225,6 +225,10 @@ bool TriggerSkill::triggerable(const ServerPlayer *target) const{
     return target != NULL && target->isAlive() && target->hasSkill(objectName());
 }
 
+bool TriggerSkill::isGlobal() const{
+    return false;
+}
+
 ScenarioRule::ScenarioRule(Scenario *scenario)
     :TriggerSkill(scenario->objectName())
 {
@@ -239,6 +243,10 @@ bool ScenarioRule::triggerable(const ServerPlayer *) const{
     return true;
 }
 
+bool ScenarioRule::isGlobal() const{
+    return true;
+}
+
 MasochismSkill::MasochismSkill(const QString &name)
     :TriggerSkill(name)
 {
@@ -407,6 +415,10 @@ bool WeaponSkill::triggerable(const ServerPlayer *target) const{
     return target->hasWeapon(objectName());
 }
 
+bool WeaponSkill::isGlobal() const{
+    return true;
+}
+
 int WeaponSkill::secondPriority() const{
     return 0;
 }
@@ -422,6 +434,10 @@ bool ArmorSkill::triggerable(const ServerPlayer *target) const{
     return target->hasArmorEffect(objectName()) && target->getArmor()->getSkill() == this;
 }
 
+bool ArmorSkill::isGlobal() const{
+    return true;
+}
+
 int ArmorSkill::secondPriority() const{
     return 0;
 }
@@ -118,6 +118,11 @@ public:
     virtual bool triggerable(const ServerPlayer *target) const;
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const = 0;
 
+    // a global skill may trigger on players that do not own it, so the room thread
+    // has to ask it on every event; override it whenever triggerable stops requiring
+    // the target to have this skill
+    virtual bool isGlobal() const;
+
 protected:
     const ViewAsSkill *view_as_skill;
     QList<TriggerEvent> events;
@@ -133,6 +138,7 @@ public:
 
     virtual int getPriority() const;
     virtual bool triggerable(const ServerPlayer *target) const;
+    virtual bool isGlobal() const;
 };
 
 class MasochismSkill: public TriggerSkill{
@@ -246,6 +252,7 @@ public:
     WeaponSkill(const QString &name);
 
     virtual bool triggerable(const ServerPlayer *target) const;
+    virtual bool isGlobal() const;
     virtual int secondPriority() const;
 };
 
@@ -256,6 +263,7 @@ public:
     ArmorSkill(const QString &name);
 
     virtual bool triggerable(const ServerPlayer *target) const;
+    virtual bool isGlobal() const;
     virtual int secondPriority() const;
 };
 
@@ -4,11 +4,96 @@
 #include <QVariant>
 #include <QStringList>
 #include <QMessageBox>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QThread>
 
 extern "C" {
     int luaopen_sgs(lua_State *);
 }
 
+// Compiled chunks are cached next to each script as "<script>c", and a cache
+// entry is only used while both the mtime and the MD5 of the source match.
+static const char *LuaCacheMagic = "QSGSLUAC";
+
+static int LuaCacheWriter(lua_State *, const void *p, size_t size, void *ud){
+    QByteArray *bytecode = static_cast<QByteArray *>(ud);
+    bytecode->append(static_cast<const char *>(p), size);
+    return 0;
+}
+
+int LoadLuaScript(lua_State *L, const char *script){
+    QFile file(QString::fromLocal8Bit(script));
+    if(!file.open(QIODevice::ReadOnly))
+        return luaL_loadfile(L, script);
+
+    QByteArray source = file.readAll();
+    file.close();
+
+    // luaL_loadfile skips a leading "#!" line, which luaL_loadbuffer does not
+    if(source.startsWith('#'))
+        return luaL_loadfile(L, script);
+
+    QByteArray chunkname = QByteArray("@") + script;
+    QByteArray hash = QCryptographicHash::hash(source, QCryptographicHash::Md5);
+    qint64 mtime = QFileInfo(file.fileName()).lastModified().toMSecsSinceEpoch();
+
+    QFile cache(file.fileName() + "c");
+    if(cache.open(QIODevice::ReadOnly)){
+        QByteArray magic, cached_hash, bytecode;
+        qint64 cached_mtime = 0;
+
+        QDataStream stream(&cache);
+        stream >> magic >> cached_mtime >> cached_hash >> bytecode;
+        cache.close();
+
+        if(stream.status() == QDataStream::Ok && magic == LuaCacheMagic
+                && cached_mtime == mtime && cached_hash == hash){
+            if(luaL_loadbuffer(L, bytecode.constData(), bytecode.size(), chunkname.constData()) == 0)
+                return 0;
+
+            // written by another build or truncated, compile from source instead
+            lua_pop(L, 1);
+        }
+    }
+
+    int error = luaL_loadbuffer(L, source.constData(), source.size(), chunkname.constData());
+    if(error)
+        return error;
+
+    // room Lua states are also loaded on a background thread, so write to a
+    // private file first and never leave a half written cache behind
+    QByteArray bytecode;
+    QFile temp(QString("%1.%2").arg(cache.fileName()).arg((quintptr)QThread::currentThreadId()));
+    if(lua_dump(L, LuaCacheWriter, &bytecode) == 0 && temp.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        QDataStream stream(&temp);
+        stream << QByteArray(LuaCacheMagic) << mtime << hash << bytecode;
+        temp.close();
+
+        QFile::remove(cache.fileName());
+        if(!temp.rename(cache.fileName()))
+            temp.remove();
+    }
+
+    return 0;
+}
+
+// replacement of the base library's dofile, so nested scripts use the cache too
+static int DoFileCached(lua_State *L){
+    const char *script = luaL_optstring(L, 1, NULL);
+    int n = lua_gettop(L);
+
+    int error = script ? LoadLuaScript(L, script) : luaL_loadfile(L, NULL);
+    if(error)
+        lua_error(L);
+
+    lua_call(L, 0, LUA_MULTRET);
+    return lua_gettop(L) - n;
+}
+
 QVariant GetValueFromLuaState(lua_State *L, const char *table_name, const char *key){
     lua_getglobal(L, table_name);
     lua_getfield(L, -1, key);
@@ -54,11 +139,13 @@ lua_State *CreateLuaState(){
     luaL_openlibs(L);
     luaopen_sgs(L);
 
+    lua_register(L, "dofile", DoFileCached);
+
     return L;
 }
 
 void DoLuaScript(lua_State *L, const char *script){
-    int error = luaL_dofile(L, script);
+    int error = LoadLuaScript(L, script) || lua_pcall(L, 0, LUA_MULTRET, 0);
     if(error){
         QString error_msg = lua_tostring(L, -1);
         QMessageBox::critical(NULL, QObject::tr("Lua script error"), error_msg);
@@ -18,6 +18,7 @@ void qShuffle(QList<T> &list){
 
 // lua interpreter related
 lua_State *CreateLuaState();
+int LoadLuaScript(lua_State *L, const char *script);
 void DoLuaScript(lua_State *L, const char *script);
 void DoLuaScripts(lua_State *L, const QStringList &scripts);
 
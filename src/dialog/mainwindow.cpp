@@ -10,6 +10,7 @@
 #include "window.h"
 //#include "halldialog.h"
 #include "nativesocket.h"
+#include "recorder.h"
 #include "pixmapanimation.h"
 #include "time.h"
 
@@ -264,13 +265,32 @@ void MainWindow::on_actionReplay_triggered()
     last_dir = file_info.absoluteDir().path();
     Config.setValue("LastReplayDir", last_dir);
 
+    startReplay(filename, -1);
+}
+
+void MainWindow::startReplay(const QString &filename, int turn){
     Client *client = new Client(this, filename);
 
+    Replayer *replayer = client->getReplayer();
+    replayer->setStartTurn(turn);
+    connect(replayer, SIGNAL(rewind_requested(int)), SLOT(rewindReplay(int)));
+
     connect(client, SIGNAL(server_connected()), SLOT(enterRoom()));
 
     client->signup();
 }
 
+void MainWindow::rewindReplay(int turn){
+    Replayer *replayer = qobject_cast<Replayer *>(sender());
+    if(replayer == NULL)
+        return;
+
+    // the old client and its replayer go away with the room scene
+    QString filename = replayer->getFilename();
+    gotoStartScene();
+    startReplay(filename, turn);
+}
+
 void MainWindow::networkError(const QString &error_msg){
     if(isVisible())
         QMessageBox::warning(this, tr("Network error"), error_msg);
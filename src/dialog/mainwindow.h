@@ -118,6 +118,7 @@ private:
     HallDialog *hall_dialog;
 
     void restoreFromConfig();
+    void startReplay(const QString &filename, int turn);
 
 public slots:
     void startConnection();
@@ -151,6 +152,7 @@ private slots:
     void enterRoom();
     void gotoScene(QGraphicsScene *scene);
     void gotoStartScene();
+    void rewindReplay(int turn);
     void sendLowLevelCommand();
     void startGameInAnotherInstance();
     void changeBackground();
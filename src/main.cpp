@@ -10,11 +10,13 @@
 #include "settings.h"
 #include "banpair.h"
 #include "server.h"
+#include "selfplay.h"
+#include "replayanalyzer.h"
 #include "audio.h"
 
 int main(int argc, char *argv[])
 {
-    if(argc > 1 && strcmp(argv[1], "-server") == 0)
+    if(argc > 1 && (strcmp(argv[1], "-server") == 0 || strncmp(argv[1], "-analyze:", 9) == 0))
         new QCoreApplication(argc, argv);
     else
         new QApplication(argc, argv);
@@ -37,11 +39,69 @@ int main(int argc, char *argv[])
     qApp->installTranslator(&qt_translator);
     qApp->installTranslator(&translator);
 
+    // "-analyze:<dir> [-jobs:N] [-output:stats.csv|stats.json]", needs no engine
+    if(argc > 1 && strncmp(argv[1], "-analyze:", 9) == 0){
+        QString path, output = "stats.csv";
+        int jobs = 0;
+
+        foreach(QString arg, qApp->arguments()){
+            if(arg.startsWith("-analyze:")){
+                arg.remove("-analyze:");
+                path = arg;
+            }else if(arg.startsWith("-jobs:")){
+                arg.remove("-jobs:");
+                jobs = arg.toInt();
+            }else if(arg.startsWith("-output:")){
+                arg.remove("-output:");
+                output = arg;
+            }
+        }
+
+        ReplayAnalyzer analyzer(path, jobs, output);
+        return analyzer.run() ? 0 : 1;
+    }
+
     Sanguosha = new Engine;
     Config.init();
     BanPair::loadBanPairs();
 
+    // "-server [-luapool:N] [-workers:N] [-selfplay:N [-jobs:N] [-output:file]]",
+    // -workers:N lets at most N rooms compute at once (0 for one per core),
+    // no limit is the default, see RoomScheduler
     if(qApp->arguments().contains("-server")){
+        int selfplay_games = 0, selfplay_jobs = 0;
+        QString selfplay_output = "selfplay.jsonl";
+
+        foreach(QString arg, qApp->arguments()){
+            if(arg.startsWith("-luapool:")){
+                arg.remove("-luapool:");
+                Config.LuaStatePoolSize = arg.toInt();
+            }else if(arg.startsWith("-workers:")){
+                arg.remove("-workers:");
+                Config.RoomWorkers = arg.toInt();
+            }else if(arg.startsWith("-selfplay:")){
+                arg.remove("-selfplay:");
+                selfplay_games = arg.toInt();
+            }else if(arg.startsWith("-jobs:")){
+                arg.remove("-jobs:");
+                selfplay_jobs = arg.toInt();
+            }else if(arg.startsWith("-output:")){
+                arg.remove("-output:");
+                selfplay_output = arg;
+            }
+        }
+
+        if(selfplay_games > 0){
+            SelfPlay *selfplay = new SelfPlay(qApp, selfplay_games, selfplay_jobs, selfplay_output);
+            QObject::connect(selfplay, SIGNAL(all_finished()), qApp, SLOT(quit()));
+            if(!selfplay->start()){
+                printf("Can not open %s\n", qPrintable(selfplay_output));
+                return 1;
+            }
+
+            return qApp->exec();
+        }
+
         Server *server = new Server(qApp);
         printf("Server is starting on port %u\n", Config.ServerPort);
 
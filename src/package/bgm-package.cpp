@@ -114,6 +114,10 @@ public:
         return target->hasUsed("LihunCard");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *diaochan, QVariant &data) const{
         PhaseChangeStruct phase_change = data.value<PhaseChangeStruct>();
 
@@ -615,6 +619,10 @@ public:
         return target != NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         QList<ServerPlayer *>lvmengs = room->findPlayersBySkillName(objectName());
 
@@ -809,6 +817,10 @@ public:
         return player != NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         switch(event){
         case GameStart:{
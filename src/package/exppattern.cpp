@@ -1,14 +1,17 @@
 #include <exppattern.h>
 
+static const uint AnyBits = ~0u;
+
 ExpPattern::ExpPattern(const QString &exp)
 {
-    this->exp = exp;
+    foreach(QString one_exp, exp.split('#'))
+        terms << Compile(one_exp);
 }
 
 bool ExpPattern::match(const Player *player, const Card *card) const
 {
-    foreach(QString one_exp,this->exp.split('#'))
-        if(this->matchOne(player,card,one_exp))return true;
+    foreach(const Term &term, terms)
+        if(matchOne(player, card, term))return true;
 
     return false;
 }
@@ -19,30 +22,30 @@ bool ExpPattern::match(const Player *player, const Card *card) const
 // 2nd patt means the card suit, and ',' means more than one options.
 // 3rd part means the card number, and ',' means more than one options,
 // the number uses '~' to make a scale for valid expressions
-bool ExpPattern::matchOne(const Player *player, const Card *card, QString exp) const
+ExpPattern::Term ExpPattern::Compile(const QString &exp)
 {
     QStringList factors = exp.split('|');
 
-    bool checkpoint = false;
-    QStringList card_types = factors.at(0).split(',');
-    foreach(QString name,card_types)
-        if(card->inherits(name.toLocal8Bit().data()) || name == ".")checkpoint = true;
-    if(!checkpoint)return false;
-    if(factors.size()<2)return true;
-
-    checkpoint = false;
-    QStringList card_suits = factors.at(1).split(',');
-    foreach(QString suit,card_suits)
-        if(card->getSuitString() == suit || suit == ".")checkpoint = true;
-    if(!checkpoint)return false;
-    if(factors.size()<3)return true;
-
-    checkpoint = false;
-    QStringList card_numbers = factors.at(2).split(',');
-    int cdn = card->getNumber();
+    Term term;
+    term.any_class = false;
+    term.suits = term.numbers = term.places = term.colors = AnyBits;
 
-    foreach(QString number,card_numbers)
-    {
+    foreach(QString name, factors.at(0).split(',')){
+        if(name == ".")term.any_class = true;
+        else term.classes << name.toLocal8Bit();
+    }
+    if(factors.size()<2)return term;
+
+    term.suits = 0;
+    foreach(QString suit, factors.at(1).split(',')){
+        if(suit == ".")term.suits = AnyBits;
+        for(int i = Card::Spade; i <= Card::NoSuit; i++)
+            if(Card::Suit2String(static_cast<Card::Suit>(i)) == suit)term.suits |= 1u << i;
+    }
+    if(factors.size()<3)return term;
+
+    term.numbers = 0;
+    foreach(QString number, factors.at(2).split(',')){
         if(number.contains('~'))
         {
             QStringList params = number.split('~');
@@ -52,27 +55,56 @@ bool ExpPattern::matchOne(const Player *player, const Card *card, QString exp) c
             if(!params.at(1).size())to = 13;
             else to =params.at(1).toInt();
 
-            if(from<= cdn && cdn <= to)checkpoint = true;
+            for(int i = qMax(from, 0); i <= qMin(to, 31); i++)
+                term.numbers |= 1u << i;
+        }
+        else if(number == ".")term.numbers = AnyBits;
+        else{
+            int n = number.toInt();
+            if(n >= 0 && n < 32)term.numbers |= 1u << n;
         }
-        else if(number.toInt() == cdn)checkpoint = true;
-        else if(number == ".")checkpoint = true;
     }
-    if(!checkpoint)return false;
-    if(factors.size()<4)return true;
+    if(factors.size()<4)return term;
 
-    checkpoint = false;
     QString place = factors.at(3);
-    if(place == ".")checkpoint = true;
-    else if(place == "equipped" && player->hasEquip(card))checkpoint = true;
-    else if(place == "hand" && !player->hasEquip(card))checkpoint = true;
-    if(!checkpoint)return false;
-    if(factors.size()<5)return true;
+    if(place == ".")term.places = AnyBits;
+    else if(place == "equipped")term.places = EquipPlace;
+    else if(place == "hand")term.places = HandPlace;
+    else term.places = 0;
+    if(factors.size()<5)return term;
 
     QString color = factors.at(4);
-    if(color == ".")return true;
-    else if (color == "red" && card->isRed())return true;
-    else if (color == "black" && card->isBlack())return true;
+    if(color == ".")term.colors = AnyBits;
+    else if(color == "red")term.colors = 1u << Card::Red;
+    else if(color == "black")term.colors = 1u << Card::Black;
+    else term.colors = 0;
 
-    return false;
+    return term;
+}
+
+bool ExpPattern::matchOne(const Player *player, const Card *card, const Term &term) const
+{
+    if(!term.any_class){
+        bool checkpoint = false;
+        foreach(const QByteArray &name, term.classes)
+            if(card->inherits(name.constData())){
+                checkpoint = true;
+                break;
+            }
+        if(!checkpoint)return false;
+    }
+
+    if(!(term.suits & (1u << card->getSuit())))return false;
+
+    int cdn = card->getNumber();
+    if(term.numbers != AnyBits){
+        if(cdn < 0 || cdn >= 32 || !(term.numbers & (1u << cdn)))return false;
+    }
+
+    if(term.places != AnyBits){
+        uint place = player->hasEquip(card) ? EquipPlace : HandPlace;
+        if(!(term.places & place))return false;
+    }
 
+    return term.colors & (1u << card->getColor());
 }
@@ -5,14 +5,35 @@
 #include <card.h>
 #include <player.h>
 
+#include <QByteArray>
+
 class ExpPattern : public CardPattern
 {
 public:
     ExpPattern(const QString &exp);
     virtual bool match(const Player *player, const Card *card) const;
+
 private:
-    QString exp;
-    bool matchOne(const Player *player,const Card *card, QString exp) const;
+    // one alternative of the expression, compiled into bit sets;
+    // a set with all bits on matches anything
+    struct Term{
+        bool any_class;
+        QList<QByteArray> classes;
+        uint suits;   // indexed by Card::Suit
+        uint numbers; // indexed by card number
+        uint places;  // HandPlace and EquipPlace
+        uint colors;  // indexed by Card::Color
+    };
+
+    enum Place{
+        HandPlace = 0x1,
+        EquipPlace = 0x2
+    };
+
+    QList<Term> terms;
+
+    static Term Compile(const QString &exp);
+    bool matchOne(const Player *player, const Card *card, const Term &term) const;
 };
 
 #endif // EXPPATTERN_H
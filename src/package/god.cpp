@@ -49,6 +49,10 @@ public:
         return target->hasSkill("wuhun");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *shenguanyu, QVariant &) const{
         QList<ServerPlayer *> players = room->getOtherPlayers(shenguanyu);
 
@@ -765,6 +769,10 @@ public:
         return target->getMark("@gale") > 0;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *player, QVariant &data) const{
         DamageStruct damage = data.value<DamageStruct>();
         if(damage.nature == DamageStruct::Fire){
@@ -883,6 +891,10 @@ public:
         return target->getMark("@fog") > 0;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *player, QVariant &data) const{
         DamageStruct damage = data.value<DamageStruct>();
         if(damage.nature != DamageStruct::Thunder){
@@ -941,6 +953,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *player, QVariant &data) const{
         DamageStar damage = data.value<DamageStar>();
         ServerPlayer *killer = damage ? damage->from : NULL;
@@ -1133,6 +1149,10 @@ public:
         return target && target->getPhase() == Player::NotActive;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *player) const{
         Room *room = player->getRoom();
         ServerPlayer *shensimayi = room->findPlayerBySkillName("lianpo");
@@ -1173,6 +1193,10 @@ public:
         return target && target->getPhase() == Player::NotActive;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *player) const{
         Room *room = player->getRoom();
         if(!room->getTag("LianpoInvoke").isNull())
@@ -267,6 +267,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
         CardUseStruct use = data.value<CardUseStruct>();
         if(use.card->inherits("Peach")){
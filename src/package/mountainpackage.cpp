@@ -182,6 +182,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
         DamageStruct damage = data.value<DamageStruct>();
         if(damage.card == NULL || !damage.card->inherits("Slash") || damage.to->isDead())
@@ -633,6 +637,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         if(event == GameStart){
             if(!player->hasLordSkill(objectName()))
@@ -805,6 +813,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *, QVariant &data) const{
         ServerPlayer *erzhang = room->findPlayerBySkillName(objectName());
         ServerPlayer *current = room->getCurrent();
@@ -842,6 +854,10 @@ public:
         return !target->hasSkill("guzheng");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual int getPriority() const{
         return -1;
     }
@@ -1002,6 +1018,10 @@ public:
         return target != NULL && target->getPhase() == Player::NotActive;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *liushan) const{
         Room *room = liushan->getRoom();
         if(!room->getTag("FangquanTarget").isNull())
@@ -1029,6 +1049,10 @@ public:
                 && target->getMark("ruoyu") == 0;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *liushan) const{
         Room *room = liushan->getRoom();
 
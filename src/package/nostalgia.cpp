@@ -21,8 +21,10 @@ public:
             CardUseStruct card_use = data.value<CardUseStruct>();
             card = card_use.card;
 
+            // the response is matched once, the pointer kept must not outlive it
             if(card == player->tag["MoonSpearSlash"].value<CardStar>()){
                 card = NULL;
+                player->tag.remove("MoonSpearSlash");
             }
         }else if(event == CardResponsed){
             ResponsedStar resp = data.value<ResponsedStar>();
@@ -160,6 +162,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *, QVariant &data) const{
         CardEffectStruct effect = data.value<CardEffectStruct>();
 
@@ -518,6 +524,10 @@ public:
         return target && !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *player, QVariant &) const{
         if(player->getPhase() != Player::RoundStart || player->isKongcheng())
             return false;
@@ -23,8 +23,10 @@ public:
             CardUseStruct card_use = data.value<CardUseStruct>();
             card = card_use.card;
 
+            // the response is matched once, the pointer kept must not outlive it
             if(card == player->tag["MoonSpearSlash"].value<CardStar>()){
                 card = NULL;
+                player->tag.remove("MoonSpearSlash");
             }
         }else if(event == CardResponsed){
             ResponsedStar resp = data.value<ResponsedStar>();
@@ -76,6 +78,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *target) const{
         if(target->getPhase() == Player::NotActive){
             Room *room = target->getRoom();
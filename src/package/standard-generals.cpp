@@ -39,6 +39,10 @@ public:
         return target->hasLordSkill("hujia");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *caocao, QVariant &data) const{
         QString pattern = data.toString();
         if(pattern != "jink")
@@ -315,6 +319,10 @@ public:
         return target->hasFlag("luoyi") && target->isAlive();
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual int getPriority() const{
         return 3;
     }
@@ -504,6 +512,10 @@ public:
         return target != NULL && target->hasLordSkill("jijiang");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *liubei, QVariant &data) const{
         QString pattern = data.toString();
         if(pattern != "slash")
@@ -639,6 +651,10 @@ public:
         return target != NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
 
         CardUseStruct use = data.value<CardUseStruct>();
@@ -819,6 +835,10 @@ public:
         return target && target->hasLordSkill("jiuyuan");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *sunquan, QVariant &data) const{
         switch(event){
         case Dying: {
@@ -19,6 +19,10 @@ public:
         return !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual int getPriority() const{
         return 2;
     }
@@ -119,6 +123,10 @@ public:
         return target->getKingdom() == "wei";
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
         JudgeStar judge = data.value<JudgeStar>();
         CardStar card = judge->card;
@@ -232,6 +240,10 @@ public:
         return target && !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         if(event == Predamage)
         {
@@ -371,6 +383,10 @@ public:
         return target && !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual int getPriority() const{
         return -1;
     }
@@ -697,6 +713,10 @@ public:
         return jiaxu->hasSkill(objectName()) && jiaxu->isAlive();
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         ServerPlayer *jiaxu = room->getCurrent();
         if(event == Dying)
@@ -760,6 +780,10 @@ public:
         return target && target->hasFlag("Luanwu");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room *room, ServerPlayer *player, QVariant &) const{
         room->setPlayerFlag(player, "-Luanwu");
         room->setPlayerMark(player, "Luanwu", 0);
@@ -909,6 +933,10 @@ public:
         return target->hasSkill(objectName()) || target->getGeneral()->isFemale();
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *, QVariant &data) const{
         SlashEffectStruct effect = data.value<SlashEffectStruct>();
         if(effect.from->hasSkill(objectName()) && effect.to->getGeneral()->isFemale()){
@@ -997,6 +1025,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &) const{
         if(event == PreHpReuced)
             player->tag["InvokeBaonue"] = player->getKingdom() == "qun";
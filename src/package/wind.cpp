@@ -235,6 +235,10 @@ public:
         return target && target->hasLordSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual void onGameStart(ServerPlayer *zhangjiao) const{
         Room *room = zhangjiao->getRoom();
         QList<ServerPlayer *> players = room->getAlivePlayers();
@@ -416,6 +420,10 @@ public:
         return target != NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
         CardUseStruct use = data.value<CardUseStruct>();
         ServerPlayer *huangzhong = use.from;
@@ -745,6 +753,10 @@ public:
         return target != NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *xiaoqiao, QVariant &data) const{
         if(event == DamageComplete){
             if(!room->getTag("TianxiangTarget").isNull())
@@ -63,6 +63,10 @@ public:
         return target->getMark("juao") > 0;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *player) const{
         if(player->getPhase() == Player::Start){
             Room *room = player->getRoom();
@@ -138,6 +142,10 @@ public:
         return target != NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *, QVariant &data) const{
         ServerPlayer *xuyou = room->findPlayerBySkillName(objectName());
         if(!xuyou) return false;
@@ -438,6 +446,10 @@ public:
         return target->hasLordSkill("weidai");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *sunce, QVariant &data) const{
         DyingStruct dying = data.value<DyingStruct>();
         if(dying.who != sunce)
@@ -494,6 +506,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
         ServerPlayer *zhangzhao = room->findPlayerBySkillName(objectName());
         if(!zhangzhao)
@@ -596,6 +612,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual int secondPriority() const{
         return 2;
     }
@@ -647,6 +667,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &) const{
         if(player->getPhase() != Player::Judge || player->getJudgingArea().length() == 0)
             return false;
@@ -790,6 +814,10 @@ public:
                 && target->getMark("@shouye") > 6;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &) const{
         if (player == NULL) return false;
 
@@ -820,6 +848,10 @@ public:
         return !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         if (player == NULL) return false;
         if(player->getMark("forbid_shien") > 0)
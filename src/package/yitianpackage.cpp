@@ -493,6 +493,10 @@ public:
         return target->getMark("@tied") > 0 && !target->hasSkill("lianli");
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *player, QVariant &data) const{
         QString pattern = data.toString();
         if(pattern != "slash")
@@ -619,6 +623,10 @@ public:
         return target->getMark("@tied") > 0;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual void onDamaged(ServerPlayer *target, const DamageStruct &damage) const{
         Room *room = target->getRoom();
         ServerPlayer *xiahoujuan = room->findPlayerBySkillName(objectName());
@@ -694,6 +702,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
         ServerPlayer *xuandi = room->findPlayerBySkillName(objectName());
         if(xuandi == NULL)
@@ -744,6 +756,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent, Room* room, ServerPlayer *, QVariant &data) const{
         ServerPlayer *xuandi = room->findPlayerBySkillName(objectName());
         if(xuandi == NULL)
@@ -1112,6 +1128,10 @@ public:
         return target->getMark("@conspiracy") > 0;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual int getPriority() const{
         return -2;
     }
@@ -1470,6 +1490,10 @@ public:
         return target && !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &) const{
         ServerPlayer *dengshizai = room->findPlayerBySkillName(objectName());
 
@@ -1690,6 +1714,10 @@ public:
         return target && !target->hasSkill(objectName());
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *player, QVariant &data) const{
         if(player->getPhase() != Player::Discard)
             return false;
@@ -59,6 +59,10 @@ public:
         return target == NULL;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent , Room* room, ServerPlayer *, QVariant &data) const{
         ServerPlayer *caozhi = room->findPlayerBySkillName(objectName());
         if(!caozhi)
@@ -780,6 +784,10 @@ public:
         return true;
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent,  Room* room, ServerPlayer *player, QVariant &) const{
         if(player->getPhase() == Player::NotActive)
             room->setTag("Zhichi", QVariant());
@@ -917,6 +925,10 @@ public:
         return !player->isKongcheng();
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool trigger(TriggerEvent ,  Room* room, ServerPlayer *player, QVariant &data) const{
         if (player == NULL) return false;
         QList<ServerPlayer *> wuguots = room->findPlayersBySkillName(objectName());
@@ -72,6 +72,10 @@ public:
         return target->isLord();
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *target) const{
         Room *room = target->getRoom();
         QList<ServerPlayer *> players = room->getAlivePlayers();
@@ -132,6 +132,10 @@ public:
                 && ! target->getRoom()->getTag("BurnWuchao").toBool();
     }
 
+    virtual bool isGlobal() const{
+        return true;
+    }
+
     virtual bool onPhaseChange(ServerPlayer *zhangliao) const{
         if(zhangliao->getPhase() == Player::Draw){
             Room *room = zhangliao->getRoom();
@@ -7,6 +7,10 @@
 #include "lua.hpp"
 #include "scenario.h"
 #include "aux-skills.h"
+#include "servermetrics.h"
+#include "relationtable.h"
+
+#include <QElapsedTimer>
 
 AI::AI(ServerPlayer *player)
     :self(player)
@@ -14,20 +18,6 @@ AI::AI(ServerPlayer *player)
     room = player->getRoom();
 }
 
-typedef QPair<QString, QString> RolePair;
-
-struct RoleMapping: public QMap<RolePair, AI::Relation> {
-    void set(const QString &role1, const QString &role2, AI::Relation relation, bool reverse = false){
-        insert(qMakePair(role1, role2), relation);
-        if(reverse)
-            insert(qMakePair(role2, role1), relation);
-    }
-
-    AI::Relation get(const QString &role1, const QString &role2){
-        return value(qMakePair(role1, role2), AI::Neutrality);
-    }
-};
-
 AI::Relation AI::GetRelation3v3(const ServerPlayer *a, const ServerPlayer *b){
     QChar c = a->getRole().at(0);
     if(b->getRole().startsWith(c))
@@ -37,69 +27,11 @@ AI::Relation AI::GetRelation3v3(const ServerPlayer *a, const ServerPlayer *b){
 }
 
 AI::Relation AI::GetRelationHegemony(const ServerPlayer *a, const ServerPlayer *b){
-    const bool aShown = a->getRoom()->getTag(a->objectName()).toStringList().isEmpty();
-    const bool bShown = b->getRoom()->getTag(b->objectName()).toStringList().isEmpty();
-
-    const QString aName = aShown ?
-                a->getGeneralName() :
-                a->getRoom()->getTag(a->objectName()).toStringList().first();
-    const QString bName = bShown ?
-                b->getGeneralName() :
-                b->getRoom()->getTag(b->objectName()).toStringList().first();
-
-    const QString aKingdom = Sanguosha->getGeneral(aName)->getKingdom();
-    const QString bKingdom = Sanguosha->getGeneral(bName)->getKingdom();
-
-
-    qDebug() << aKingdom << bKingdom <<aShown << bShown;
-
-    return aKingdom == bKingdom ? Friend :Enemy;
+    return a->getRoom()->getRelationTable()->hegemonyRelation(a, b);
 }
 
 AI::Relation AI::GetRelation(const ServerPlayer *a, const ServerPlayer *b){
-    RoleMapping map, map_good, map_bad;
-    if(map.isEmpty()){
-        map.set("lord", "lord", Friend);
-        map.set("lord", "rebel", Enemy);
-        map.set("lord", "loyalist", Friend);
-        map.set("lord", "renegade", Neutrality);
-
-        map.set("loyalist", "loyalist", Friend);
-        map.set("loyalist", "lord", Friend);
-        map.set("loyalist", "rebel", Enemy);
-        map.set("loyalist", "renegade", Neutrality);
-
-        map.set("rebel", "rebel", Friend);
-        map.set("rebel", "lord", Enemy);
-        map.set("rebel", "loyalist", Enemy);
-        map.set("rebel", "renegade", Neutrality);
-
-        map.set("renegade", "lord", Friend);
-        map.set("renegade", "loyalist", Neutrality);
-        map.set("renegade", "rebel", Neutrality);
-        map.set("renegade", "renegade", Neutrality);
-
-        map_good = map;
-        map_good.set("renegade", "loyalist", Enemy, true);
-        map_good.set("renegade", "rebel", Friend, true);
-
-        map_bad = map;
-        map_bad.set("renegade", "loyalist", Friend, true);
-        map_bad.set("renegade", "rebel", Enemy, true);
-    }
-
-    if(a->aliveCount() == 2){
-        return Enemy;
-    }
-
-    Room *room = a->getRoom();
-    QString process = room->getTag("GameProcess").toString();
-    if(process == "Balance")
-        return map.get(a->getRole(), b->getRole());
-    else if(process == "LordSuperior")
-        return map_good.get(a->getRole(), b->getRole());
-    else
-        return map_bad.get(a->getRole(), b->getRole());
+    return a->getRoom()->getRelationTable()->relation(a, b);
 }
 
 AI::Relation AI::relationTo(const ServerPlayer *other) const{
@@ -387,7 +319,7 @@ void TrustAI::askForGuanxing(const QList<int> &cards, QList<int> &up, QList<int>
 }
 
 LuaAI::LuaAI(ServerPlayer *player)
-    :TrustAI(player), callback(0)
+    :TrustAI(player), callback(0), current_callback(NULL)
 {
 
 }
@@ -403,7 +335,7 @@ QString LuaAI::askForUseCard(const QString &pattern, const QString &prompt){
     lua_pushstring(L, pattern.toAscii());
     lua_pushstring(L, prompt.toAscii());
 
-    int error = lua_pcall(L, 3, 1, 0);
+    int error = callLua(L, 3, 1);
     const char *result = lua_tostring(L, -1);
     lua_pop(L, 1);
 
@@ -426,7 +358,7 @@ QList<int> LuaAI::askForDiscard(const QString &reason, int discard_num, int min_
     lua_pushboolean(L, optional);
     lua_pushboolean(L, include_equip);
 
-    int error = lua_pcall(L, 6, 1, 0);
+    int error = callLua(L, 6, 1);
     if(error){
         reportError(L);
         return TrustAI::askForDiscard(reason, discard_num, min_num, optional, include_equip);
@@ -466,7 +398,7 @@ int LuaAI::askForAG(const QList<int> &card_ids, bool refusable, const QString &r
     lua_pushboolean(L, refusable);
     lua_pushstring(L, reason.toAscii());
 
-    int error = lua_pcall(L, 4, 1, 0);
+    int error = callLua(L, 4, 1);
     if(error){
         reportError(L);
         return TrustAI::askForAG(card_ids, refusable, reason);
@@ -483,6 +415,101 @@ void LuaAI::pushCallback(lua_State *L, const char *function_name){
 
     lua_rawgeti(L, LUA_REGISTRYINDEX, callback);
     lua_pushstring(L, function_name);
+    current_callback = function_name;
+}
+
+// the budget of the decision running in a Lua state, kept in its registry under BudgetKey;
+// it is wall-clock time, so it bounds how long the room waits on its AI, and
+// time the room thread is preempted by other rooms counts against it too
+struct DecisionBudget{
+    QElapsedTimer timer;
+    qint64 limit;
+    bool exceeded;
+    QString where;
+};
+
+static char BudgetKey;
+
+// checked every BudgetHookCount instructions
+static const int BudgetHookCount = 1000;
+
+static DecisionBudget *SwapBudget(lua_State *L, DecisionBudget *budget){
+    lua_pushlightuserdata(L, &BudgetKey);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    DecisionBudget *old = static_cast<DecisionBudget *>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+
+    lua_pushlightuserdata(L, &BudgetKey);
+    if(budget)
+        lua_pushlightuserdata(L, budget);
+    else
+        lua_pushnil(L);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+
+    return old;
+}
+
+static void BudgetHook(lua_State *L, lua_Debug *ar){
+    lua_pushlightuserdata(L, &BudgetKey);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    DecisionBudget *budget = static_cast<DecisionBudget *>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+
+    if(budget == NULL || budget->timer.elapsed() <= budget->limit)
+        return;
+
+    // keeps raising until the decision unwinds, so a pcall inside the AI can not swallow it
+    if(!budget->exceeded){
+        budget->exceeded = true;
+        if(lua_getinfo(L, "Sln", ar))
+            budget->where = QString("%1:%2 (%3)").arg(ar->short_src).arg(ar->currentline)
+                    .arg(ar->name ? ar->name : "?");
+    }
+
+    luaL_error(L, "AI decision exceeded its budget of %d ms", (int)budget->limit);
+}
+
+int LuaAI::callLua(lua_State *L, int nargs, int nresults, bool budgeted){
+    DecisionBudget budget;
+    budget.limit = budgeted ? Config.AIDecisionBudget : 0;
+    budget.exceeded = false;
+    budget.timer.start();
+
+    // a nested unbudgeted call keeps running under the budget of its outer decision
+    lua_Hook old_hook = lua_gethook(L);
+    int old_mask = lua_gethookmask(L), old_count = lua_gethookcount(L);
+    DecisionBudget *old_budget = NULL;
+    if(budget.limit > 0){
+        old_budget = SwapBudget(L, &budget);
+        lua_sethook(L, BudgetHook, LUA_MASKCOUNT, BudgetHookCount);
+    }
+
+    int error = lua_pcall(L, nargs, nresults, 0);
+
+    if(budget.limit > 0){
+        SwapBudget(L, old_budget);
+        lua_sethook(L, old_hook, old_mask, old_count);
+    }
+
+    qint64 elapsed = budget.timer.elapsed();
+    ServerMetrics::GetInstance()->recordAIDecision(current_callback, elapsed);
+
+    if(budget.exceeded){
+        ServerMetrics::GetInstance()->recordAIOverrun(current_callback);
+
+        // the callback wrapper may have caught the error and returned normally
+        if(error == 0){
+            lua_pop(L, nresults);
+            lua_pushstring(L, "AI decision exceeded its budget");
+            error = LUA_ERRRUN;
+        }
+
+        room->output(QString("AI %1 of %2 gave up after %3 ms in %4")
+                     .arg(current_callback).arg(self->getGeneralName())
+                     .arg(elapsed).arg(budget.where));
+    }
+
+    return error;
 }
 
 void LuaAI::pushQIntList(lua_State *L, const QList<int> &list){
@@ -508,9 +535,11 @@ void LuaAI::askForGuanxing(const QList<int> &cards, QList<int> &up, QList<int> &
     pushQIntList(L, cards);
     lua_pushboolean(L, up_only);
 
-    int error = lua_pcall(L, 3, 2, 0);
+    int error = callLua(L, 3, 2);
     if(error){
         reportError(L);
+        up.clear();
+        bottom.clear();
         return TrustAI::askForGuanxing(cards, up, bottom, up_only);
     }
 
@@ -117,7 +117,13 @@ public:
     LuaFunction callback;
 
 private:
+    const char *current_callback;
+
     void pushCallback(lua_State *L, const char *function_name);
+    // lua_pcall on the pushed callback, its duration goes to ServerMetrics;
+    // a budgeted call running over Config.AIDecisionBudget ms fails,
+    // so the caller answers what TrustAI would
+    int callLua(lua_State *L, int nargs, int nresults, bool budgeted = true);
     void pushQIntList(lua_State *L, const QList<int> &list);
     void reportError(lua_State *L);
     bool getTable(lua_State *L, QList<int> &table);
@@ -0,0 +1,142 @@
+#include "cardpile.h"
+#include "util.h"
+
+CardPile::CardPile()
+    :head(0), tail(0), num(0), snapshot_valid(false)
+{
+}
+
+CardPile::CardPile(const QList<int> &card_ids)
+    :head(0), tail(0), num(0), snapshot_valid(false)
+{
+    foreach(int card_id, card_ids)
+        append(card_id);
+}
+
+bool CardPile::contains(int card_id) const{
+    return card_id >= 0 && card_id < index.size() && index.at(card_id) != -1;
+}
+
+int CardPile::first() const{
+    Q_ASSERT(num > 0);
+    return slots.at(head);
+}
+
+int CardPile::takeFirst(){
+    int card_id = first();
+    removeOne(card_id);
+    return card_id;
+}
+
+void CardPile::prepend(int card_id){
+    if(card_id < 0)
+        return;
+
+    removeOne(card_id);
+    if(head == 0)
+        compact(qMax(num, 16));
+
+    ensureIndex(card_id);
+    slots[--head] = card_id;
+    index[card_id] = head;
+    num++;
+    snapshot_valid = false;
+}
+
+void CardPile::append(int card_id){
+    if(card_id < 0)
+        return;
+
+    removeOne(card_id);
+    if(tail == slots.size())
+        compact(head);
+
+    ensureIndex(card_id);
+    index[card_id] = tail;
+    slots[tail++] = card_id;
+    num++;
+    snapshot_valid = false;
+}
+
+bool CardPile::removeOne(int card_id){
+    if(!contains(card_id))
+        return false;
+
+    int pos = index.at(card_id);
+    slots[pos] = -1;
+    index[card_id] = -1;
+    num--;
+    snapshot_valid = false;
+
+    // keep both ends on live cards so that first() never looks at a hole
+    if(num == 0){
+        head = tail = slots.size() / 2;
+    }else{
+        while(slots.at(head) == -1)
+            head++;
+        while(slots.at(tail - 1) == -1)
+            tail--;
+    }
+
+    if(tail - head > 2 * num + 16)
+        compact(qMax(num, 16));
+
+    return true;
+}
+
+void CardPile::clear(){
+    slots.clear();
+    index.clear();
+    head = tail = num = 0;
+    snapshot_valid = false;
+}
+
+void CardPile::shuffle(){
+    QList<int> card_ids = toList();
+    qShuffle(card_ids);
+
+    clear();
+    foreach(int card_id, card_ids)
+        append(card_id);
+}
+
+QList<int> CardPile::toList() const{
+    if(!snapshot_valid){
+        snapshot.clear();
+        snapshot.reserve(num);
+        for(int i = head; i < tail; i++){
+            if(slots.at(i) != -1)
+                snapshot << slots.at(i);
+        }
+
+        snapshot_valid = true;
+    }
+
+    return snapshot;
+}
+
+void CardPile::compact(int front_space){
+    QVector<int> packed(front_space + num + qMax(num, 16), -1);
+    int pos = front_space;
+    for(int i = head; i < tail; i++){
+        int card_id = slots.at(i);
+        if(card_id != -1){
+            packed[pos] = card_id;
+            index[card_id] = pos++;
+        }
+    }
+
+    slots = packed;
+    head = front_space;
+    tail = pos;
+}
+
+void CardPile::ensureIndex(int card_id){
+    int old_size = index.size();
+    if(card_id < old_size)
+        return;
+
+    index.resize(card_id + 16);
+    for(int i = old_size; i < index.size(); i++)
+        index[i] = -1;
+}
@@ -0,0 +1,45 @@
+#ifndef CARDPILE_H
+#define CARDPILE_H
+
+#include <QList>
+#include <QVector>
+
+// An ordered pile of card ids (draw pile, discard pile, ...).
+// Every card remembers its slot, so taking a card out of the middle of the
+// pile does not scan it; the hole is skipped until the pile is compacted.
+class CardPile
+{
+public:
+    CardPile();
+    explicit CardPile(const QList<int> &card_ids);
+
+    inline int length() const{ return num; }
+    inline int count() const{ return num; }
+    inline bool isEmpty() const{ return num == 0; }
+    bool contains(int card_id) const;
+
+    int first() const;
+    int takeFirst();
+    void prepend(int card_id);
+    void append(int card_id);
+    bool removeOne(int card_id);
+    void clear();
+    void shuffle();
+
+    // a snapshot shared with the pile until it changes, so repeated
+    // queries between two moves do not copy the pile again
+    QList<int> toList() const;
+
+private:
+    QVector<int> slots; // card ids in pile order, -1 marks a removed card
+    QVector<int> index; // card id -> position in slots, -1 when not in the pile
+    int head, tail, num;
+
+    mutable QList<int> snapshot;
+    mutable bool snapshot_valid;
+
+    void compact(int front_space);
+    void ensureIndex(int card_id);
+};
+
+#endif // CARDPILE_H
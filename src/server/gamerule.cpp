@@ -30,6 +30,10 @@ bool GameRule::triggerable(const ServerPlayer *) const{
     return true;
 }
 
+bool GameRule::isGlobal() const{
+    return true;
+}
+
 int GameRule::getPriority() const{
     return 0;
 }
@@ -158,14 +162,20 @@ void GameRule::setGameProcess(Room *room) const{
     }
 
     QString process;
-    if(good == bad)
+    RelationTable::Process process_enum;
+    if(good == bad){
         process = "Balance";
-    else if(good > bad)
+        process_enum = RelationTable::Balance;
+    }else if(good > bad){
         process = "LordSuperior";
-    else
+        process_enum = RelationTable::LordSuperior;
+    }else{
         process = "RebelSuperior";
+        process_enum = RelationTable::RebelSuperior;
+    }
 
     room->setTag("GameProcess", process);
+    room->getRelationTable()->setProcess(process_enum);
 }
 
 bool GameRule::trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const{
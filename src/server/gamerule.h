@@ -11,6 +11,7 @@ public:
     void setGameProcess(Room *room) const;
 
     virtual bool triggerable(const ServerPlayer *target) const;
+    virtual bool isGlobal() const;
     virtual int getPriority() const;
     virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const;
 
@@ -0,0 +1,334 @@
+#include "gamestate.h"
+#include "serverplayer.h"
+#include "room.h"
+#include "atom.h"
+
+class PlayerStateData: public QSharedData
+{
+public:
+    PlayerStateData()
+        :seat(0), phase(Player::NotActive), hp(0), max_hp(0),
+          alive(true), face_up(true), chained(false)
+    {
+    }
+
+    QString object_name, general, general2, kingdom, role;
+    int seat;
+    Player::Phase phase;
+    int hp, max_hp;
+    bool alive, face_up, chained;
+
+    QList<int> handcards, equips, judging_area;
+    QMap<QString, QList<int> > piles;
+    QMap<int, int> marks; // keyed by atoms, as in Player
+    QSet<int> flags;
+};
+
+class GameStateData: public QSharedData
+{
+public:
+    GameStateData()
+        :current(-1)
+    {
+    }
+
+    QVector<PlayerState> players;
+    QList<int> draw_pile, discard_pile;
+    int current;
+};
+
+PlayerState::PlayerState()
+    :d(new PlayerStateData)
+{
+}
+
+PlayerState::PlayerState(const ServerPlayer *player)
+    :d(new PlayerStateData)
+{
+    d->object_name = player->objectName();
+    d->general = player->getGeneralName();
+    d->general2 = player->getGeneral2Name();
+    d->kingdom = player->getKingdom();
+    d->role = player->getRole();
+    d->seat = player->getSeat();
+    d->phase = player->getPhase();
+    d->hp = player->getHp();
+    d->max_hp = player->getMaxHp();
+    d->alive = player->isAlive();
+    d->face_up = player->faceUp();
+    d->chained = player->isChained();
+
+    d->handcards = player->handCards();
+    foreach(const Card *card, player->getEquips())
+        d->equips << card->getEffectiveId();
+    foreach(const Card *card, player->getJudgingArea())
+        d->judging_area << card->getEffectiveId();
+
+    const Player *base = player;
+    d->piles = base->piles;
+    d->marks = base->marks;
+    d->flags = base->flags;
+}
+
+PlayerState::PlayerState(const PlayerState &other)
+    :d(other.d)
+{
+}
+
+PlayerState &PlayerState::operator=(const PlayerState &other){
+    d = other.d;
+    return *this;
+}
+
+PlayerState::~PlayerState(){
+}
+
+QString PlayerState::objectName() const{
+    return d->object_name;
+}
+
+QString PlayerState::getGeneralName() const{
+    return d->general;
+}
+
+QString PlayerState::getGeneral2Name() const{
+    return d->general2;
+}
+
+QString PlayerState::getKingdom() const{
+    return d->kingdom;
+}
+
+QString PlayerState::getRole() const{
+    return d->role;
+}
+
+int PlayerState::getSeat() const{
+    return d->seat;
+}
+
+Player::Phase PlayerState::getPhase() const{
+    return d->phase;
+}
+
+void PlayerState::setPhase(Player::Phase phase){
+    d->phase = phase;
+}
+
+int PlayerState::getHp() const{
+    return d->hp;
+}
+
+void PlayerState::setHp(int hp){
+    d->hp = hp;
+}
+
+int PlayerState::getMaxHp() const{
+    return d->max_hp;
+}
+
+void PlayerState::setMaxHp(int max_hp){
+    d->max_hp = max_hp;
+}
+
+bool PlayerState::isAlive() const{
+    return d->alive;
+}
+
+void PlayerState::setAlive(bool alive){
+    d->alive = alive;
+}
+
+bool PlayerState::faceUp() const{
+    return d->face_up;
+}
+
+void PlayerState::setFaceUp(bool face_up){
+    d->face_up = face_up;
+}
+
+bool PlayerState::isChained() const{
+    return d->chained;
+}
+
+void PlayerState::setChained(bool chained){
+    d->chained = chained;
+}
+
+int PlayerState::getMark(const QString &mark) const{
+    return d->marks.value(AtomTable::Find(mark), 0);
+}
+
+void PlayerState::setMark(const QString &mark, int value){
+    d->marks[AtomTable::Intern(mark)] = value;
+}
+
+bool PlayerState::hasFlag(const QString &flag) const{
+    return d->flags.contains(AtomTable::Find(flag));
+}
+
+void PlayerState::setFlags(const QString &flag){
+    if(flag.startsWith('-'))
+        d->flags.remove(AtomTable::Find(flag.mid(1)));
+    else
+        d->flags.insert(AtomTable::Intern(flag));
+}
+
+QList<int> PlayerState::handCards() const{
+    return d->handcards;
+}
+
+QList<int> PlayerState::getEquips() const{
+    return d->equips;
+}
+
+QList<int> PlayerState::getJudgingArea() const{
+    return d->judging_area;
+}
+
+QList<int> PlayerState::getPile(const QString &pile_name) const{
+    return d->piles.value(pile_name);
+}
+
+void PlayerState::addCard(int card_id, Player::Place place, const QString &pile_name){
+    switch(place){
+    case Player::PlaceHand: d->handcards << card_id; break;
+    case Player::PlaceEquip: d->equips << card_id; break;
+    case Player::PlaceDelayedTrick: d->judging_area << card_id; break;
+    case Player::PlaceSpecial: d->piles[pile_name] << card_id; break;
+    default:
+        break;
+    }
+}
+
+bool PlayerState::hasCard(int card_id) const{
+    if(d->handcards.contains(card_id) || d->equips.contains(card_id) || d->judging_area.contains(card_id))
+        return true;
+
+    foreach(const QList<int> &pile, d->piles){
+        if(pile.contains(card_id))
+            return true;
+    }
+
+    return false;
+}
+
+bool PlayerState::removeCard(int card_id){
+    // look before detaching, so that a miss does not copy the seat
+    const PlayerStateData *data = d.constData();
+    if(data->handcards.contains(card_id))
+        return d->handcards.removeOne(card_id);
+    if(data->equips.contains(card_id))
+        return d->equips.removeOne(card_id);
+    if(data->judging_area.contains(card_id))
+        return d->judging_area.removeOne(card_id);
+
+    QMapIterator<QString, QList<int> > itor(data->piles);
+    while(itor.hasNext()){
+        itor.next();
+        if(itor.value().contains(card_id))
+            return d->piles[itor.key()].removeOne(card_id);
+    }
+
+    return false;
+}
+
+// -----------------------------------
+
+GameState::GameState()
+    :d(new GameStateData)
+{
+}
+
+GameState::GameState(const Room *room)
+    :d(new GameStateData)
+{
+    ServerPlayer *current = room->getCurrent();
+    foreach(ServerPlayer *player, room->getPlayers()){
+        if(player == current)
+            d->current = d->players.size();
+        d->players << PlayerState(player);
+    }
+
+    d->draw_pile = room->getDrawPile();
+    d->discard_pile = room->getDiscardPile();
+}
+
+GameState::GameState(const GameState &other)
+    :d(other.d)
+{
+}
+
+GameState &GameState::operator=(const GameState &other){
+    d = other.d;
+    return *this;
+}
+
+GameState::~GameState(){
+}
+
+int GameState::playerCount() const{
+    return d->players.size();
+}
+
+const PlayerState &GameState::player(int index) const{
+    return d->players.at(index);
+}
+
+PlayerState &GameState::player(int index){
+    return d->players[index];
+}
+
+int GameState::indexOf(const QString &object_name) const{
+    for(int i = 0; i < d->players.size(); i++){
+        if(d->players.at(i).objectName() == object_name)
+            return i;
+    }
+
+    return -1;
+}
+
+int GameState::currentIndex() const{
+    return d->current;
+}
+
+void GameState::setCurrentIndex(int index){
+    d->current = index;
+}
+
+const QList<int> &GameState::getDrawPile() const{
+    return d->draw_pile;
+}
+
+const QList<int> &GameState::getDiscardPile() const{
+    return d->discard_pile;
+}
+
+int GameState::drawCard(int player_index){
+    if(d.constData()->draw_pile.isEmpty())
+        return -1;
+
+    int card_id = d->draw_pile.takeFirst();
+    player(player_index).addCard(card_id, Player::PlaceHand);
+    return card_id;
+}
+
+void GameState::discardCard(int card_id){
+    // search through the shared data first, so that only the seat
+    // holding the card gets detached
+    const GameStateData *data = d.constData();
+    int holder = -1;
+    for(int i = 0; i < data->players.size(); i++){
+        if(data->players.at(i).hasCard(card_id)){
+            holder = i;
+            break;
+        }
+    }
+    bool in_draw_pile = holder == -1 && data->draw_pile.contains(card_id);
+
+    if(holder != -1)
+        d->players[holder].removeCard(card_id);
+    else if(in_draw_pile)
+        d->draw_pile.removeOne(card_id);
+    d->discard_pile.prepend(card_id);
+}
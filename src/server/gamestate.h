@@ -0,0 +1,102 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include "player.h"
+
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QVector>
+#include <QMetaType>
+
+class Room;
+class ServerPlayer;
+class PlayerStateData;
+class GameStateData;
+
+// A detached copy of one seat: general, hp, cards, marks, flags and piles.
+// Copies share their data until one of them is modified.
+class PlayerState
+{
+public:
+    PlayerState();
+    explicit PlayerState(const ServerPlayer *player);
+    PlayerState(const PlayerState &other);
+    PlayerState &operator=(const PlayerState &other);
+    ~PlayerState();
+
+    QString objectName() const;
+    QString getGeneralName() const;
+    QString getGeneral2Name() const;
+    QString getKingdom() const;
+    QString getRole() const;
+    int getSeat() const;
+    Player::Phase getPhase() const;
+    void setPhase(Player::Phase phase);
+
+    int getHp() const;
+    void setHp(int hp);
+    int getMaxHp() const;
+    void setMaxHp(int max_hp);
+    bool isAlive() const;
+    void setAlive(bool alive);
+    bool faceUp() const;
+    void setFaceUp(bool face_up);
+    bool isChained() const;
+    void setChained(bool chained);
+
+    int getMark(const QString &mark) const;
+    void setMark(const QString &mark, int value);
+    bool hasFlag(const QString &flag) const;
+    void setFlags(const QString &flag);
+
+    // cards are kept as ids; place is one of PlaceHand, PlaceEquip,
+    // PlaceDelayedTrick or PlaceSpecial (with the pile name)
+    QList<int> handCards() const;
+    QList<int> getEquips() const;
+    QList<int> getJudgingArea() const;
+    QList<int> getPile(const QString &pile_name) const;
+    bool hasCard(int card_id) const;
+    void addCard(int card_id, Player::Place place, const QString &pile_name = QString());
+    bool removeCard(int card_id);
+
+private:
+    QSharedDataPointer<PlayerStateData> d;
+};
+
+// A detached snapshot of a whole game: every seat, the draw and discard piles
+// and whose turn it is. Copying a GameState only takes a reference; data is
+// copied lazily, and only for the seats a fork actually changes, so search
+// based AI can fork one state per branch without the room, sockets or Lua.
+class GameState
+{
+public:
+    GameState();
+    explicit GameState(const Room *room);
+    GameState(const GameState &other);
+    GameState &operator=(const GameState &other);
+    ~GameState();
+
+    inline GameState fork() const{ return *this; }
+
+    int playerCount() const;
+    const PlayerState &player(int index) const;
+    PlayerState &player(int index);
+    int indexOf(const QString &object_name) const;
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+
+    const QList<int> &getDrawPile() const;
+    const QList<int> &getDiscardPile() const;
+
+    // takes the top card of the draw pile, or -1 if it is empty
+    int drawCard(int player_index);
+    // moves a card from wherever it is to the discard pile
+    void discardCard(int card_id);
+
+private:
+    QSharedDataPointer<GameStateData> d;
+};
+
+Q_DECLARE_METATYPE(GameState)
+
+#endif // GAMESTATE_H
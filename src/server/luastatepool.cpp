@@ -0,0 +1,152 @@
+#include "luastatepool.h"
+#include "util.h"
+#include "lua.hpp"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+
+LuaStatePool::LuaStatePool(QObject *parent)
+    :QThread(parent), capacity(0), stopped(false)
+{
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(shutdown()));
+}
+
+LuaStatePool *LuaStatePool::GetInstance(){
+    static LuaStatePool *pool;
+    if(pool == NULL)
+        pool = new LuaStatePool(qApp);
+
+    return pool;
+}
+
+QStringList LuaStatePool::RoomScripts(){
+    QStringList scripts;
+    scripts << "lua/sanguosha.lua" << "lua/ai/smart-ai.lua";
+    return scripts;
+}
+
+void LuaStatePool::setCapacity(int capacity){
+    QMutexLocker locker(&mutex);
+    this->capacity = qMax(capacity, 0);
+    wait_condition.wakeAll();
+
+    if(this->capacity > 0 && !isRunning())
+        start(QThread::LowPriority);
+}
+
+int LuaStatePool::getCapacity() const{
+    QMutexLocker locker(&mutex);
+    return capacity;
+}
+
+int LuaStatePool::getReadyCount() const{
+    QMutexLocker locker(&mutex);
+    return ready.length();
+}
+
+lua_State *LuaStatePool::acquire(){
+    lua_State *L = NULL;
+
+    mutex.lock();
+    if(!ready.isEmpty())
+        L = ready.dequeue();
+    wait_condition.wakeAll();
+    mutex.unlock();
+
+    if(L == NULL){
+        // the pool is drained or disabled, load in place as before
+        L = CreateRoomLuaState();
+        DoLuaScripts(L, RoomScripts());
+    }
+
+    return L;
+}
+
+void LuaStatePool::recycle(lua_State *L){
+    if(L == NULL)
+        return;
+
+    QMutexLocker locker(&mutex);
+    if(stopped || !isRunning()){
+        locker.unlock();
+        lua_close(L);
+        return;
+    }
+
+    to_close.enqueue(L);
+    wait_condition.wakeAll();
+}
+
+// Room states run sanguosha.lua for the skills and AI it defines, but the
+// packages and translations belong to the engine, which loaded them on the
+// main thread already; "room_state" tells the script to leave the engine alone.
+lua_State *LuaStatePool::CreateRoomLuaState(){
+    lua_State *L = CreateLuaState();
+    lua_pushboolean(L, 1);
+    lua_setglobal(L, "room_state");
+    return L;
+}
+
+lua_State *LuaStatePool::LoadRoomLuaState(){
+    lua_State *L = CreateRoomLuaState();
+
+    // DoLuaScript pops up a message box on error, which is not allowed
+    // outside the GUI thread, so report it here and leave it to acquire()
+    foreach(QString script, RoomScripts()){
+        QByteArray name = script.toLocal8Bit();
+        if(LoadLuaScript(L, name.constData()) || lua_pcall(L, 0, LUA_MULTRET, 0)){
+            qWarning("Lua state pool: %s", lua_tostring(L, -1));
+            lua_close(L);
+            return NULL;
+        }
+    }
+
+    return L;
+}
+
+void LuaStatePool::run(){
+    forever{
+        lua_State *dead = NULL;
+
+        mutex.lock();
+        while(!stopped && to_close.isEmpty() && ready.length() >= capacity)
+            wait_condition.wait(&mutex);
+
+        if(stopped){
+            mutex.unlock();
+            break;
+        }
+
+        if(!to_close.isEmpty())
+            dead = to_close.dequeue();
+        mutex.unlock();
+
+        if(dead){
+            lua_close(dead);
+            continue;
+        }
+
+        lua_State *L = LoadRoomLuaState();
+
+        QMutexLocker locker(&mutex);
+        if(L)
+            ready.enqueue(L);
+        else
+            capacity = 0; // the scripts are broken, stop retrying
+    }
+
+    QMutexLocker locker(&mutex);
+    while(!ready.isEmpty())
+        lua_close(ready.dequeue());
+    while(!to_close.isEmpty())
+        lua_close(to_close.dequeue());
+}
+
+void LuaStatePool::shutdown(){
+    mutex.lock();
+    stopped = true;
+    wait_condition.wakeAll();
+    mutex.unlock();
+
+    wait();
+}
@@ -0,0 +1,54 @@
+#ifndef LUASTATEPOOL_H
+#define LUASTATEPOOL_H
+
+struct lua_State;
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QStringList>
+
+// Keeps a number of room Lua states with the AI scripts already loaded,
+// so that creating a room does not parse the scripts on the main event loop.
+// States are filled and closed on a low priority background thread.
+class LuaStatePool : public QThread
+{
+    Q_OBJECT
+
+public:
+    static LuaStatePool *GetInstance();
+    static QStringList RoomScripts();
+
+    void setCapacity(int capacity);
+    int getCapacity() const;
+    int getReadyCount() const;
+
+    // Takes a ready state out of the pool, or loads one synchronously
+    // when the pool is empty. The caller owns the returned state.
+    lua_State *acquire();
+
+    // Gives back a state that a finished room no longer uses. Game scripts
+    // leave their globals all over a used state, so it is closed on the
+    // background thread and its slot is refilled with a fresh one.
+    void recycle(lua_State *L);
+
+protected:
+    virtual void run();
+
+private:
+    explicit LuaStatePool(QObject *parent);
+    static lua_State *CreateRoomLuaState();
+    static lua_State *LoadRoomLuaState();
+
+    mutable QMutex mutex;
+    QWaitCondition wait_condition;
+    QQueue<lua_State *> ready, to_close;
+    int capacity;
+    bool stopped;
+
+private slots:
+    void shutdown();
+};
+
+#endif // LUASTATEPOOL_H
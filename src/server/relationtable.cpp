@@ -0,0 +1,191 @@
+#include "relationtable.h"
+#include "serverplayer.h"
+#include "room.h"
+#include "engine.h"
+
+// [process][role of a][role of b], roles in the order of Player::Role:
+// lord, loyalist, rebel, renegade
+static const AI::Relation F = AI::Friend, E = AI::Enemy, N = AI::Neutrality;
+static const AI::Relation RoleRelations[3][4][4] = {
+    // Balance
+    {
+        {F, F, E, N},
+        {F, F, E, N},
+        {E, E, F, N},
+        {F, N, N, N},
+    },
+
+    // LordSuperior, the renegade sides with the rebels
+    {
+        {F, F, E, N},
+        {F, F, E, E},
+        {E, E, F, F},
+        {F, E, F, N},
+    },
+
+    // RebelSuperior, the renegade sides with the loyalists
+    {
+        {F, F, E, N},
+        {F, F, E, F},
+        {E, E, F, E},
+        {F, F, E, N},
+    },
+};
+
+RelationTable::RelationTable()
+    :process(RebelSuperior), player_count(0), generation(1)
+{
+    for(int i = 0; i < MaxPlayers; i++){
+        players[i] = NULL;
+        kingdom_generations[i] = 0;
+    }
+
+    clearIntentions();
+}
+
+void RelationTable::setProcess(Process process){
+    this->process = process;
+}
+
+RelationTable::Process RelationTable::getProcess() const{
+    return process;
+}
+
+void RelationTable::invalidate(){
+    generation++;
+}
+
+AI::Relation RelationTable::relation(const ServerPlayer *a, const ServerPlayer *b) const{
+    if(a->aliveCount() == 2)
+        return AI::Enemy;
+
+    return RoleRelations[process][a->getRoleEnum()][b->getRoleEnum()];
+}
+
+AI::Relation RelationTable::hegemonyRelation(const ServerPlayer *a, const ServerPlayer *b){
+    return kingdomOf(a) == kingdomOf(b) ? AI::Friend : AI::Enemy;
+}
+
+int RelationTable::indexOf(const ServerPlayer *player) const{
+    for(int i = 0; i < player_count; i++){
+        if(players[i] == player)
+            return i;
+    }
+
+    return -1;
+}
+
+int RelationTable::assign(const ServerPlayer *player){
+    int index = indexOf(player);
+    if(index == -1 && player_count < MaxPlayers){
+        index = player_count++;
+        players[index] = player;
+    }
+
+    return index;
+}
+
+// the kingdom of the real general, hidden ones are kept in the room tag named after the player
+const QString &RelationTable::kingdomOf(const ServerPlayer *player){
+    static const QString unknown;
+
+    int index = assign(player);
+    if(index == -1)
+        return unknown;
+
+    if(kingdom_generations[index] != generation){
+        QStringList hidden = player->getRoom()->getTag(player->objectName()).toStringList();
+        QString name = hidden.isEmpty() ? player->getGeneralName() : hidden.first();
+        const General *general = Sanguosha->getGeneral(name);
+
+        kingdoms[index] = general ? general->getKingdom() : QString();
+        kingdom_generations[index] = generation;
+    }
+
+    return kingdoms[index];
+}
+
+void RelationTable::addIntention(const ServerPlayer *from, const ServerPlayer *to, int intention){
+    int a = assign(from), b = assign(to);
+    if(a == -1 || b == -1)
+        return;
+
+    intentions[a][b] += intention;
+    intention_counts[a][b]++;
+}
+
+int RelationTable::getIntention(const ServerPlayer *from, const ServerPlayer *to) const{
+    int a = indexOf(from), b = indexOf(to);
+    if(a == -1 || b == -1)
+        return 0;
+
+    return intentions[a][b];
+}
+
+int RelationTable::getIntentionCount(const ServerPlayer *from, const ServerPlayer *to) const{
+    int a = indexOf(from), b = indexOf(to);
+    if(a == -1 || b == -1)
+        return 0;
+
+    return intention_counts[a][b];
+}
+
+// Hostility towards the lord counts for the rebels, and so does hostility
+// towards the players found loyal in the previous pass, while hostility
+// towards the players found rebel counts for the loyalists. Two passes are
+// enough for the few seats of a game to settle.
+QString RelationTable::evaluateRole(const ServerPlayer *player) const{
+    if(player->isLord())
+        return "loyalist";
+
+    int lord = indexOf(player->getRoom()->getLord());
+    int index = indexOf(player);
+    if(lord == -1 || index == -1)
+        return "unknown";
+
+    int sides[MaxPlayers]; // 1 for rebel, -1 for loyalist, 0 for unknown
+    for(int i = 0; i < player_count; i++)
+        sides[i] = 0;
+    sides[lord] = -1;
+
+    int scores[MaxPlayers];
+    for(int pass = 0; pass < 2; pass++){
+        for(int i = 0; i < player_count; i++){
+            scores[i] = 0;
+            for(int j = 0; j < player_count; j++){
+                if(sides[j] == -1)
+                    scores[i] += intentions[i][j];
+                else if(sides[j] == 1)
+                    scores[i] -= intentions[i][j];
+            }
+        }
+
+        for(int i = 0; i < player_count; i++){
+            if(i == lord)
+                continue;
+
+            if(scores[i] >= RoleThreshold)
+                sides[i] = 1;
+            else if(scores[i] <= -RoleThreshold)
+                sides[i] = -1;
+            else
+                sides[i] = 0;
+        }
+    }
+
+    if(sides[index] == 1)
+        return "rebel";
+    else if(sides[index] == -1)
+        return "loyalist";
+    else
+        return "unknown";
+}
+
+void RelationTable::clearIntentions(){
+    for(int i = 0; i < MaxPlayers; i++){
+        for(int j = 0; j < MaxPlayers; j++){
+            intentions[i][j] = 0;
+            intention_counts[i][j] = 0;
+        }
+    }
+}
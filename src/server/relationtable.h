@@ -0,0 +1,65 @@
+#ifndef RELATIONTABLE_H
+#define RELATIONTABLE_H
+
+class ServerPlayer;
+
+#include "ai.h"
+
+#include <QString>
+
+// Answers the role relations AI::relationTo asks for in one room. The
+// relations of each game process are compiled into a constant table indexed by
+// role, so a query is an array lookup; the hegemony kingdoms are cached per
+// player until a tag or a player property of the room changes.
+// It also keeps the intention matrix the Lua AI feeds from sgs.updateIntention:
+// the sum of the intentions each player has shown towards each other player.
+// evaluateRole infers a side from it, sgs.backwardEvaluation falls back on it
+// when counting the roles left does not settle an unknown player.
+class RelationTable
+{
+public:
+    enum Process { Balance, LordSuperior, RebelSuperior };
+
+    RelationTable();
+
+    // the game rule sets it whenever the balance of the roles changes
+    void setProcess(Process process);
+    Process getProcess() const;
+    void invalidate();
+
+    AI::Relation relation(const ServerPlayer *a, const ServerPlayer *b) const;
+    AI::Relation hegemonyRelation(const ServerPlayer *a, const ServerPlayer *b);
+
+    void addIntention(const ServerPlayer *from, const ServerPlayer *to, int intention);
+    int getIntention(const ServerPlayer *from, const ServerPlayer *to) const;
+    int getIntentionCount(const ServerPlayer *from, const ServerPlayer *to) const;
+    void clearIntentions();
+
+    // "rebel" or "loyalist" as the player's intentions show, "unknown" while
+    // they are too weak to tell; intentions alone can not single out a renegade
+    QString evaluateRole(const ServerPlayer *player) const;
+
+private:
+    static const int MaxPlayers = 16;
+
+    // about one clearly hostile or friendly card, as sgs.ai_card_intention rates them
+    static const int RoleThreshold = 80;
+
+    int indexOf(const ServerPlayer *player) const;
+    int assign(const ServerPlayer *player);
+    const QString &kingdomOf(const ServerPlayer *player);
+
+    Process process;
+
+    const ServerPlayer *players[MaxPlayers];
+    int player_count;
+
+    unsigned int generation;
+    unsigned int kingdom_generations[MaxPlayers];
+    QString kingdoms[MaxPlayers];
+
+    int intentions[MaxPlayers][MaxPlayers];
+    int intention_counts[MaxPlayers][MaxPlayers];
+};
+
+#endif // RELATIONTABLE_H
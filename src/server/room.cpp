@@ -14,6 +14,10 @@
 #include "generalselector.h"
 #include "jsonutils.h"
 #include "structs.h"
+#include "luastatepool.h"
+#include "roomscheduler.h"
+#include "servermetrics.h"
+#include "atom.h"
 
 #include <QStringList>
 #include <QMessageBox>
@@ -28,11 +32,14 @@
 using namespace QSanProtocol;
 using namespace QSanProtocol::Utils;
 
+// checked for both ends of every card move
+static const int CardMovingFlag = AtomTable::Intern("CardMoving");
+
 Room::Room(QObject *parent, const QString &mode)
     :QThread(parent), mode(mode), current(NULL), pile1(Sanguosha->getRandomCards()),
     draw_pile(&pile1), discard_pile(&pile2), deal_pile(&pile3), top_drawpile(&pile4),
     game_started(false), game_finished(false), m_surrenderRequestReceived(false), L(NULL), thread(NULL),
-    thread_3v3(NULL), sem(new QSemaphore), _m_semRaceRequest(0), _m_semRoomMutex(1),
+    thread_3v3(NULL), sem(new QSemaphore), _m_semRaceRequest(0), _m_semRoomMutex(1), _m_semBroadcastReply(0),
     _m_raceStarted(false), provided(NULL), has_provided(false), _virtual(false)
 
 {
@@ -45,10 +52,9 @@ Room::Room(QObject *parent, const QString &mode)
 
     initCallbacks();
 
-    L = CreateLuaState();
-    QStringList scripts;
-    scripts << "lua/sanguosha.lua" << "lua/ai/smart-ai.lua";
-    DoLuaScripts(L, scripts);
+    L = LuaStatePool::GetInstance()->acquire();
+    RoomScheduler::GetInstance()->prepareThread(this);
+    distance_matrix.setChecking(Config.DistanceCacheCheck);
 
     //20120320
     monitor_timer= new QTimer(this);
@@ -57,6 +63,11 @@ Room::Room(QObject *parent, const QString &mode)
     connect(ready_timer, SIGNAL(timeout()), this, SLOT(Ready_timerTrigger()));
 }
 
+Room::~Room(){
+    releaseVirtualCards();
+    releaseVirtualCards();
+}
+
 void Room::initCallbacks(){
     // init request response pair
     m_requestResponsePair[S_COMMAND_PLAY_CARD] = S_COMMAND_USE_CARD;
@@ -88,6 +99,7 @@ void Room::initCallbacks(){
 
     //Client request
     callbacks["networkDelayTestCommand"] = &Room::networkDelayTestCommand;
+    callbacks["binaryPacketCommand"] = &Room::binaryPacketCommand;
 }
 
 ServerPlayer *Room::getCurrent() const{
@@ -567,6 +579,8 @@ bool Room::doRequest(ServerPlayer* player, QSanProtocol::CommandType command, co
         player->m_expectedReplyCommand = m_requestResponsePair[command];
     else
         player->m_expectedReplyCommand = command;
+    player->m_requestedCommand = command;
+    player->m_requestTime.start();
 
     player->invoke(&packet);
     player->releaseLock(ServerPlayer::SEMA_MUTEX);
@@ -574,27 +588,61 @@ bool Room::doRequest(ServerPlayer* player, QSanProtocol::CommandType command, co
     else return true;
 }
 
-bool Room::doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command)
+bool Room::doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command,
+                              ResponseCallback callback, void *callbackArg)
 {
     time_t timeOut = ServerInfo.getCommandTimeout(command, S_SERVER_INSTANCE);
-    return doBroadcastRequest(players, command, timeOut);
+    return doBroadcastRequest(players, command, timeOut, callback, callbackArg);
 }
 
-bool Room::doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command, time_t timeOut)
+bool Room::doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command, time_t timeOut,
+                              ResponseCallback callback, void *callbackArg)
 {
+    _m_semBroadcastReply.tryAcquire(_m_semBroadcastReply.available()); // drain lock
     foreach (ServerPlayer* player, players)
     {
+        player->m_replyListener = &_m_semBroadcastReply;
         doRequest(player, command, player->m_commandArgs, timeOut, false);
     }
+
+    // Every release of a player's SEMA_COMMAND_INTERACTIVE also releases _m_semBroadcastReply,
+    // so we wake up once per completion and collect whoever is done, in the order they answer.
+    QList<ServerPlayer*> pending = players;
     QTime timer;
-    time_t remainTime = timeOut;
     timer.start();
-    foreach (ServerPlayer* player, players)
+    forever
+    {
+        QMutableListIterator<ServerPlayer*> itor(pending);
+        while (itor.hasNext())
+        {
+            ServerPlayer *player = itor.next();
+            if (player->isOnline() && player->getSemaphore(ServerPlayer::SEMA_COMMAND_INTERACTIVE)->available() == 0)
+                continue;
+            getResult(player, 0);
+            itor.remove();
+            if (callback) (this->*callback)(player, callbackArg);
+        }
+        if (pending.isEmpty()) break;
+
+        RoomScheduler::Parking parking;
+        if (Config.OperationNoLimit)
+            _m_semBroadcastReply.acquire();
+        else
+        {
+            time_t remainTime = timeOut - timer.elapsed();
+            if (remainTime < 0 || !_m_semBroadcastReply.tryAcquire(1, remainTime))
+                break;
+        }
+    }
+
+    // whoever is left has timed out
+    foreach (ServerPlayer* player, pending)
     {
-        remainTime = timeOut - timer.elapsed();
-        if (remainTime < 0) remainTime = 0;
-        getResult(player, remainTime);
+        getResult(player, 0);
+        if (callback) (this->*callback)(player, callbackArg);
     }
+    foreach (ServerPlayer* player, players)
+        player->m_replyListener = NULL;
     return true;
 }
 
@@ -624,10 +672,13 @@ ServerPlayer* Room::getRaceResult(QList<ServerPlayer*> &players, QSanProtocol::C
         time_t timeRemain = timeOut - timer.elapsed();
         if (timeRemain < 0) timeRemain = 0;
         bool tryAcquireResult = true;
-        if (Config.OperationNoLimit)
-            _m_semRaceRequest.acquire();
-        else
-            tryAcquireResult = _m_semRaceRequest.tryAcquire(1, timeRemain);
+        {
+            RoomScheduler::Parking parking;
+            if (Config.OperationNoLimit)
+                _m_semRaceRequest.acquire();
+            else
+                tryAcquireResult = _m_semRaceRequest.tryAcquire(1, timeRemain);
+        }
 
         if (!tryAcquireResult)
             _m_semRoomMutex.tryAcquire(1);
@@ -678,10 +729,9 @@ bool Room::doNotify(ServerPlayer* player, QSanProtocol::CommandType command, con
 
 bool Room::doBroadcastNotify(const QList<ServerPlayer*> &players, QSanProtocol::CommandType command, const Json::Value &arg)
 {
-    foreach (ServerPlayer* player, players)
-    {
-        doNotify(player, command, arg);
-    }
+    QSanGeneralPacket packet(S_SERVER_NOTIFICATION, command);
+    packet.setMessageBody(arg);
+    broadcastPacket(players, &packet);
     return true;
 }
 
@@ -696,7 +746,75 @@ void Room::broadcastInvoke(const char *method, const QString &arg, ServerPlayer
 
 void Room::broadcastInvoke(const QSanProtocol::QSanPacket* packet, ServerPlayer *except)
 {
-    broadcast(QString(packet->toString().c_str()), except);
+    broadcastPacket(m_players, packet, except);
+}
+
+void Room::broadcastPacket(const QList<ServerPlayer *> &players, const QSanProtocol::QSanPacket *packet, ServerPlayer *except){
+    // each format is encoded at most once and then shared by every receiver
+    QByteArray line, frame;
+    foreach(ServerPlayer *player, players){
+        if(player == except)
+            continue;
+
+        if(player->isBinaryPacket()){
+            if(frame.isNull())
+                frame = serializePacket(packet, true);
+            if(line.isNull() && player->isRecording())
+                line = serializePacket(packet, false);
+            player->unicastFrame(frame, line);
+        }else{
+            if(line.isNull())
+                line = serializePacket(packet, false);
+            player->unicastLine(line);
+        }
+    }
+}
+
+QByteArray Room::serializePacket(const QSanProtocol::QSanPacket *packet, bool binary){
+    std::string data = binary ? packet->toBinary() : packet->toString();
+    _m_serializedCount.fetchAndAddRelaxed(1);
+    _m_serializedBytes.fetchAndAddRelaxed(data.size());
+    return QByteArray(data.data(), data.size());
+}
+
+QByteArray Room::serializeMessage(const QString &message){
+    QByteArray line = message.toAscii();
+    _m_serializedCount.fetchAndAddRelaxed(1);
+    _m_serializedBytes.fetchAndAddRelaxed(line.size());
+    return line;
+}
+
+int Room::getSerializedCount() const{
+    return _m_serializedCount;
+}
+
+int Room::getSerializedBytes() const{
+    return _m_serializedBytes;
+}
+
+int Room::getMoveNotifyCount() const{
+    return _m_moveNotifyCount;
+}
+
+int Room::getMovePayloadCount() const{
+    return _m_movePayloadCount;
+}
+
+void Room::addWaitTime(int msecs){
+    _m_waitTime.fetchAndAddRelaxed(msecs);
+}
+
+int Room::getWaitTime() const{
+    return _m_waitTime;
+}
+
+void Room::requestSnapshot(){
+    _m_snapshotRequested.fetchAndStoreOrdered(1);
+}
+
+void Room::takeRequestedSnapshot(){
+    if(_m_snapshotRequested != 0 && _m_snapshotRequested.fetchAndStoreOrdered(0))
+        emit snapshot_taken(GameState(this));
 }
 
 bool Room::getResult(ServerPlayer* player, time_t timeOut){
@@ -707,10 +825,13 @@ bool Room::getResult(ServerPlayer* player, time_t timeOut){
     {
         player->releaseLock(ServerPlayer::SEMA_MUTEX);
 
-        if (Config.OperationNoLimit)
-            player->acquireLock(ServerPlayer::SEMA_COMMAND_INTERACTIVE);
-        else
-            player->tryAcquireLock(ServerPlayer::SEMA_COMMAND_INTERACTIVE, timeOut) ;
+        {
+            RoomScheduler::Parking parking;
+            if (Config.OperationNoLimit)
+                player->acquireLock(ServerPlayer::SEMA_COMMAND_INTERACTIVE);
+            else
+                player->tryAcquireLock(ServerPlayer::SEMA_COMMAND_INTERACTIVE, timeOut) ;
+        }
 
         // Note that we rely on processResponse to filter out all unrelevant packet.
         // By the time the lock is released, m_clientResponse must be the right message
@@ -722,6 +843,7 @@ bool Room::getResult(ServerPlayer* player, time_t timeOut){
         player->acquireLock(ServerPlayer::SEMA_MUTEX);
         validResult = player->m_isClientResponseReady;
     }
+    ServerMetrics::GetInstance()->recordRequest(player->m_requestedCommand, player->m_requestTime.elapsed());
     player->m_expectedReplyCommand = S_COMMAND_UNKNOWN;
     player->m_isWaitingReply = false;
     player->m_expectedReplySerial = -1;
@@ -1271,6 +1393,7 @@ void Room::clearPlayerFlags(ServerPlayer *player){
 void Room::setPlayerProperty(ServerPlayer *player, const char *property_name, const QVariant &value){
     player->setProperty(property_name, value);
     broadcastProperty(player, property_name);
+    relation_table.invalidate();
 
     if(strcmp(property_name, "hp") == 0){
         thread->trigger(HpChanged, this, player);
@@ -1384,9 +1507,10 @@ const Scenario *Room::getScenario() const{
 }
 
 void Room::broadcast(const QString &message, ServerPlayer *except){
+    QByteArray line = serializeMessage(message);
     foreach(ServerPlayer *player, m_players){
         if(player != except){
-            player->unicast(message);
+            player->unicastLine(line);
         }
     }
 }
@@ -1414,27 +1538,27 @@ void Room::swapPile(){
     broadcastInvoke("clearPile");
     broadcastInvoke("setPileNumber", QString::number(draw_pile->length()));
 
-    qShuffle(*draw_pile);
+    draw_pile->shuffle();
 
-    foreach(int card_id, *draw_pile){
+    foreach(int card_id, draw_pile->toList()){
         setCardMapping(card_id, NULL, Player::DrawPile);
     }
 }
 
-QList<int> Room::getDiscardPile(){
-    return *discard_pile;
+QList<int> Room::getDiscardPile() const{
+    return discard_pile->toList();
 }
 
-QList<int> Room::getDrawPile(){
-    return *draw_pile;
+QList<int> Room::getDrawPile() const{
+    return draw_pile->toList();
 }
 
-QList<int> Room::getDealingArea(){
-    return *deal_pile;
+QList<int> Room::getDealingArea() const{
+    return deal_pile->toList();
 }
 
-QList<int> Room::getTopDrawPile(){
-    return *top_drawpile;
+QList<int> Room::getTopDrawPile() const{
+    return top_drawpile->toList();
 }
 
 ServerPlayer *Room::findPlayer(const QString &general_name, bool include_dead) const{
@@ -1531,6 +1655,14 @@ lua_State *Room::getLuaState() const{
     return L;
 }
 
+DistanceMatrix *Room::getDistanceMatrix(){
+    return &distance_matrix;
+}
+
+RelationTable *Room::getRelationTable(){
+    return &relation_table;
+}
+
 void Room::setFixedDistance(Player *from, const Player *to, int distance){
     QString a = from->objectName();
     QString b = to->objectName();
@@ -2269,15 +2401,8 @@ void Room::chooseGenerals(){
     foreach(ServerPlayer *player, to_assign){
         _setupChooseGeneralRequestArgs(player);
     }
-    doBroadcastRequest(to_assign, S_COMMAND_CHOOSE_GENERAL);
-    foreach (ServerPlayer *player, to_assign)
-    {
-        if (player->getGeneral() != NULL) continue;
-        Json::Value generalName = player->getClientReply();
-        if (!player->m_isClientResponseReady || !generalName.isString()
-            || !_setPlayerGeneral(player, toQString(generalName), true))
-            _setPlayerGeneral(player, _chooseDefaultGeneral(player), true);
-    }
+    bool isFirst = true;
+    doBroadcastRequest(to_assign, S_COMMAND_CHOOSE_GENERAL, &Room::_setChosenGeneral, &isFirst);
 
     if(Config.Enable2ndGeneral){
         QList<ServerPlayer *> to_assign = m_players;
@@ -2285,14 +2410,8 @@ void Room::chooseGenerals(){
         foreach(ServerPlayer *player, to_assign){
             _setupChooseGeneralRequestArgs(player);
         }
-        doBroadcastRequest(to_assign, S_COMMAND_CHOOSE_GENERAL);
-        foreach(ServerPlayer *player, to_assign){
-            if (player->getGeneral2() != NULL) continue;
-            Json::Value generalName = player->getClientReply();
-            if (!player->m_isClientResponseReady || !generalName.isString()
-                || !_setPlayerGeneral(player, toQString(generalName), false))
-                _setPlayerGeneral(player, _chooseDefaultGeneral(player), false);
-        }
+        isFirst = false;
+        doBroadcastRequest(to_assign, S_COMMAND_CHOOSE_GENERAL, &Room::_setChosenGeneral, &isFirst);
     }
 
 
@@ -2309,6 +2428,8 @@ void Room::chooseGenerals(){
 }
 
 void Room::run(){
+    RoomScheduler::Slot slot(this);
+
     setGerenalGender("anjiang", "M");
     // initialize random seed for later use
     qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
@@ -2329,9 +2450,10 @@ void Room::run(){
     using_countdown = false;
 #endif
 
-    if(using_countdown){
+    if(using_countdown && Config.CountDownSeconds > 0){
         for(int i=Config.CountDownSeconds; i>=0; i--){
             broadcastInvoke("startInXs", QString::number(i));
+            RoomScheduler::Parking parking;
             sleep(1);
         }
     }else
@@ -2342,11 +2464,13 @@ void Room::run(){
         startGame();
     else if(mode == "06_3v3"){
         thread_3v3 = new RoomThread3v3(this);
+        RoomScheduler::GetInstance()->prepareThread(thread_3v3);
         thread_3v3->start();
 
         connect(thread_3v3, SIGNAL(finished()), this, SLOT(startGame()));
     }else if(mode == "02_1v1"){
         thread_1v1 = new RoomThread1v1(this);
+        RoomScheduler::GetInstance()->prepareThread(thread_1v1);
         thread_1v1->start();
 
         connect(thread_1v1, SIGNAL(finished()), this, SLOT(startGame()));
@@ -2466,7 +2590,7 @@ int Room::getCardFromPile(const QString &card_pattern){
 
     if(card_pattern.startsWith("@")){
         if(card_pattern == "@duanliang"){
-            foreach(int card_id, *draw_pile){
+            foreach(int card_id, draw_pile->toList()){
                 const Card *card = Sanguosha->getCard(card_id);
                 if(card->isBlack() && (card->inherits("BasicCard") || card->inherits("EquipCard")))
                     return card_id;
@@ -2474,7 +2598,7 @@ int Room::getCardFromPile(const QString &card_pattern){
         }
     }else{
         QString card_name = card_pattern;
-        foreach(int card_id, *draw_pile){
+        foreach(int card_id, draw_pile->toList()){
             const Card *card = Sanguosha->getCard(card_id);
             if(card->objectName() == card_name)
                 return card_id;
@@ -2522,6 +2646,16 @@ QString Room::_chooseDefaultGeneral(ServerPlayer* player) const
     }
 }
 
+void Room::_setChosenGeneral(ServerPlayer* player, void *isFirst)
+{
+    bool first = *(bool *)isFirst;
+    if ((first ? player->getGeneral() : player->getGeneral2()) != NULL) return;
+    Json::Value generalName = player->getClientReply();
+    if (!player->m_isClientResponseReady || !generalName.isString()
+        || !_setPlayerGeneral(player, toQString(generalName), first))
+        _setPlayerGeneral(player, _chooseDefaultGeneral(player), first);
+}
+
 bool Room::_setPlayerGeneral(ServerPlayer* player, const QString& generalName, bool isFirst)
 {
     const General* general = Sanguosha->getGeneral(generalName);
@@ -2927,20 +3061,21 @@ void Room::startGame(){
 
     Server *server = qobject_cast<Server *>(parent());
     foreach(ServerPlayer *player, m_players){
-        if(player->getState() == "online")
+        if(server && player->getState() == "online")
             server->signupPlayer(player);
     }
 
     current = m_players.first();
 
-    // initialize the place_map and owner_map;
-    foreach(int card_id, *draw_pile){
+    // initialize the card locations
+    foreach(int card_id, draw_pile->toList()){
         setCardMapping(card_id, NULL, Player::DrawPile);
     }
 
     broadcastInvoke("setPileNumber", QString::number(draw_pile->length()));
 
     thread = new RoomThread(this);
+    RoomScheduler::GetInstance()->prepareThread(thread);
     connect(thread, SIGNAL(started()), this, SIGNAL(game_start()));
 
     if(!_virtual)thread->start();
@@ -2984,7 +3119,7 @@ void Room::drawCards(QList<ServerPlayer*> players, int n, const QString &reason)
 
             notify_card_ids << card_id;
 
-            // update place_map & owner_map
+            // update the card locations
             setCardMapping(card_id, player, Player::PlaceHand);
         }
 
@@ -3243,7 +3378,7 @@ void Room::moveCardsAtomic(QList<CardsMoveStruct> cards_moves, bool forceMoveVis
             //trigger events
             if (cards_move.from &&
                 (cards_move.from_place == Player::PlaceHand || cards_move.from_place == Player::PlaceEquip || cards_move.from_place == Player::PlaceSpecial)
-                    && !cards_move.from->hasFlag("CardMoving")){
+                    && !cards_move.from->hasFlag(CardMovingFlag)){
                 CardMoveStar move_star = &moves[j];
                 QVariant data = QVariant::fromValue(move_star);
                 thread->trigger(CardLostOnePiece, this, (ServerPlayer*)cards_move.from, data);
@@ -3253,7 +3388,7 @@ void Room::moveCardsAtomic(QList<CardsMoveStruct> cards_moves, bool forceMoveVis
         moveOneTimeStruct.reason = cards_move.reason;
         for (int i = 0; i < cards_move.card_ids.size(); i++)
             moveOneTimeStruct.from_places.append(cards_move.from_place);
-        if (cards_move.countAsOneTime && moveOneTimeStruct.card_ids.size() > 0 && cards_move.from && !cards_move.from->hasFlag("CardMoving")){
+        if (cards_move.countAsOneTime && moveOneTimeStruct.card_ids.size() > 0 && cards_move.from && !cards_move.from->hasFlag(CardMovingFlag)){
             moveOneTimeStruct.from = cards_move.from; moveOneTimeStruct.to = cards_move.to;
             moveOneTimeStruct.to_place = cards_move.to_place;
             CardsMoveOneTimeStar lose_star = &moveOneTimeStruct;
@@ -3271,7 +3406,7 @@ void Room::moveCardsAtomic(QList<CardsMoveStruct> cards_moves, bool forceMoveVis
             if (cards_move.to &&
 				(cards_move.to != cards_move.from || cards_move.from_place ==Player::TopDrawPile) &&
                     (cards_move.to_place == Player::PlaceHand || cards_move.to_place == Player::PlaceEquip)
-                    && !cards_move.to->hasFlag("CardMoving"))
+                    && !cards_move.to->hasFlag(CardMovingFlag))
             {
                 CardMoveStar move_star = &moves[j];
                 QVariant data = QVariant::fromValue(move_star);
@@ -3289,7 +3424,7 @@ void Room::moveCardsAtomic(QList<CardsMoveStruct> cards_moves, bool forceMoveVis
             CardsMoveOneTimeStar move_star = &moveOneTimeStruct;
             QVariant data = QVariant::fromValue(move_star);
 
-            if(cards_move.to && !cards_move.to->hasFlag("CardMoving"))
+            if(cards_move.to && !cards_move.to->hasFlag(CardMovingFlag))
                 thread->trigger(CardGotOneTime, this, (ServerPlayer*)cards_move.to, data);
             else
                 thread->trigger(CardGotOneTime, this, NULL, data);
@@ -3393,7 +3528,7 @@ void Room::_moveCards(QList<CardsMoveStruct> cards_moves, bool forceMoveVisible,
             }
             //trigger events
             if ((cards_move.from_place == Player::PlaceHand || cards_move.from_place == Player::PlaceEquip || cards_move.from_place == Player::PlaceSpecial)
-                    && cards_move.from && !cards_move.from->hasFlag("CardMoving")){
+                    && cards_move.from && !cards_move.from->hasFlag(CardMovingFlag)){
                 CardMoveStar move_star = &moves[j];
                 QVariant data = QVariant::fromValue(move_star);
                 thread->trigger(CardLostOnePiece, this, (ServerPlayer*)cards_move.from, data);
@@ -3403,7 +3538,7 @@ void Room::_moveCards(QList<CardsMoveStruct> cards_moves, bool forceMoveVisible,
         moveOneTimeStruct.reason = cards_move.reason;
         for (int i = 0; i < cards_move.card_ids.size(); i++)
             moveOneTimeStruct.from_places.append(cards_move.from_place);
-        if (cards_move.countAsOneTime && moveOneTimeStruct.card_ids.size() > 0 && cards_move.from && !cards_move.from->hasFlag("CardMoving")){
+        if (cards_move.countAsOneTime && moveOneTimeStruct.card_ids.size() > 0 && cards_move.from && !cards_move.from->hasFlag(CardMovingFlag)){
             moveOneTimeStruct.from = cards_move.from; moveOneTimeStruct.to = cards_move.to;
             moveOneTimeStruct.to_place = cards_move.to_place;
             CardsMoveOneTimeStar lose_star = &moveOneTimeStruct;
@@ -3472,7 +3607,7 @@ void Room::_moveCards(QList<CardsMoveStruct> cards_moves, bool forceMoveVisible,
             if (cards_move.to &&
 				(cards_move.to != cards_move.from || cards_move.from_place == Player::TopDrawPile) &&
                     (cards_move.to_place == Player::PlaceHand || cards_move.to_place == Player::PlaceEquip)
-                    && !cards_move.to->hasFlag("CardMoving")) {
+                    && !cards_move.to->hasFlag(CardMovingFlag)) {
                 CardMoveStar move_star = &moves[j];
                 QVariant data = QVariant::fromValue(move_star);
                 thread->trigger(CardGotOnePiece, this, (ServerPlayer*)cards_move.to, data);
@@ -3489,7 +3624,7 @@ void Room::_moveCards(QList<CardsMoveStruct> cards_moves, bool forceMoveVisible,
             CardsMoveOneTimeStar move_star = &moveOneTimeStruct;
             QVariant data = QVariant::fromValue(move_star);
 
-            if(cards_move.to && !cards_move.to->hasFlag("CardMoving"))
+            if(cards_move.to && !cards_move.to->hasFlag(CardMovingFlag))
                 thread->trigger(CardGotOneTime, this, (ServerPlayer*)cards_move.to, data);
             else
                 thread->trigger(CardGotOneTime, this, NULL, data);
@@ -3501,8 +3636,13 @@ void Room::_moveCards(QList<CardsMoveStruct> cards_moves, bool forceMoveVisible,
 bool Room::notifyMoveCards(bool isLostPhase, QList<CardsMoveStruct> cards_moves, bool forceVisible)
 {
     // process dongcha
-    ServerPlayer *dongchaee = findChild<ServerPlayer *>(tag.value("Dongchaee").toString());
-    ServerPlayer *dongchaer = findChild<ServerPlayer *>(tag.value("Dongchaer").toString());
+    ServerPlayer *dongchaee = NULL, *dongchaer = NULL;
+    QString dongchaee_name = tag.value("Dongchaee").toString();
+    if (!dongchaee_name.isEmpty())
+    {
+        dongchaee = findChild<ServerPlayer *>(dongchaee_name);
+        dongchaer = findChild<ServerPlayer *>(tag.value("Dongchaer").toString());
+    }
     // Notify clients
     int moveId;
     if (isLostPhase)
@@ -3510,32 +3650,56 @@ bool Room::notifyMoveCards(bool isLostPhase, QList<CardsMoveStruct> cards_moves,
     else
         moveId = --_m_lastMovementId;
     Q_ASSERT(_m_lastMovementId >= 0);
+
+    // whether a move is shown to everybody, whoever is watching
+    QList<bool> publicMoves;
+    for (int i = 0; i < cards_moves.size(); i++)
+    {
+        publicMoves << (forceVisible ||
+            // forceVisible will override cards to be visible
+            cards_moves[i].to_place == Player::PlaceEquip || cards_moves[i].from_place == Player::PlaceEquip ||
+            cards_moves[i].to_place == Player::PlaceDelayedTrick || cards_moves[i].from_place == Player::PlaceDelayedTrick ||
+            // any card from/to discard pile should be visible
+            cards_moves[i].from_place == Player::DiscardPile || cards_moves[i].to_place == Player::DiscardPile ||
+            // @todo: fix this: all cards except yuji's guhuocard,when enters DealingArea,should be visible
+            // All cards leave DealingArea should be visible
+            (cards_moves[i].to_place == Player::DealingArea && cards_moves[i].reason.m_skillName != "guhuo") || cards_moves[i].from_place == Player::DealingArea);
+    }
+
+    // players who may see exactly the same cards share one notification,
+    // so a move costs one payload per visibility class rather than per player
+    QMap<QByteArray, QList<ServerPlayer *> > audiences;
     foreach (ServerPlayer* player, m_players)
     {
         if (player->isOffline()) continue;
+        QByteArray visibility(cards_moves.size(), '0');
+        for (int i = 0; i < cards_moves.size(); i++)
+        {
+            if (publicMoves[i] || cards_moves[i].isRelevant(player) ||
+                // card from/to dongchaee is also visible to dongchaer
+                (player == dongchaer && cards_moves[i].isRelevant(dongchaee)))
+                visibility[i] = '1';
+        }
+        audiences[visibility] << player;
+    }
+
+    CommandType command = isLostPhase ? S_COMMAND_LOSE_CARD : S_COMMAND_GET_CARD;
+    QMapIterator<QByteArray, QList<ServerPlayer *> > itor(audiences);
+    while (itor.hasNext())
+    {
+        itor.next();
         Json::Value arg(Json::arrayValue);
         arg[0] = moveId;
         for (int i = 0; i < cards_moves.size(); i++)
         {
-            cards_moves[i].open = (forceVisible || cards_moves[i].isRelevant(player) ||
-                // forceVisible will override cards to be visible
-                cards_moves[i].to_place == Player::PlaceEquip || cards_moves[i].from_place == Player::PlaceEquip ||
-                cards_moves[i].to_place == Player::PlaceDelayedTrick || cards_moves[i].from_place == Player::PlaceDelayedTrick ||
-                // any card from/to discard pile should be visible
-                cards_moves[i].from_place == Player::DiscardPile || cards_moves[i].to_place == Player::DiscardPile ||
-                // @todo: fix this: all cards except yuji's guhuocard,when enters DealingArea,should be visible
-                // All cards leave DealingArea should be visible
-                (cards_moves[i].to_place == Player::DealingArea && cards_moves[i].reason.m_skillName != "guhuo") || cards_moves[i].from_place == Player::DealingArea ||
-                // any card from/to draw-pile-top should be visible
-                (player != NULL && player == dongchaer && (cards_moves[i].isRelevant(dongchaee))));
-                // card from/to dongchaee is also visible to dongchaer
+            cards_moves[i].open = itor.key().at(i) == '1';
             arg[i + 1] = cards_moves[i].toJsonValue();
         }
-        if (isLostPhase)
-            doNotify(player, S_COMMAND_LOSE_CARD, arg);
-        else
-            doNotify(player, S_COMMAND_GET_CARD, arg);
+        doBroadcastNotify(itor.value(), command, arg);
     }
+
+    _m_moveNotifyCount.ref();
+    _m_movePayloadCount.fetchAndAddRelaxed(audiences.size());
     return true;
 }
 
@@ -3648,6 +3812,7 @@ void Room::acquireSkill(ServerPlayer *player, const QString &skill_name, bool op
 
 void Room::setTag(const QString &key, const QVariant &value){
     tag.insert(key, value);
+    relation_table.invalidate();
     if(scenario)
         scenario->onTagSet(this, key);
 }
@@ -3658,6 +3823,7 @@ QVariant Room::getTag(const QString &key) const{
 
 void Room::removeTag(const QString &key){
     tag.remove(key);
+    relation_table.invalidate();
 }
 
 void Room::setEmotion(ServerPlayer *target, const QString &emotion){
@@ -3846,18 +4012,33 @@ const Card *Room::askForExchange(ServerPlayer *player, const QString &reason, in
 }
 
 void Room::setCardMapping(int card_id, ServerPlayer *owner, Player::Place place){
-    owner_map.insert(card_id, owner);
-    place_map.insert(card_id, place);
+    if(card_id < 0)
+        return;
+
+    if(card_id >= card_locations.size()){
+        int old_size = card_locations.size();
+        card_locations.resize(qMax(card_id + 1, Sanguosha->getCardCount()));
+        for(int i = old_size; i < card_locations.size(); i++){
+            card_locations[i].place = Player::PlaceUnknown;
+            card_locations[i].owner = NULL;
+        }
+    }
+
+    CardLocation &location = card_locations[card_id];
+    location.owner = owner;
+    location.place = place;
 }
 
 ServerPlayer *Room::getCardOwner(int card_id) const{
-    return owner_map.value(card_id);
+    if(card_id < 0 || card_id >= card_locations.size())
+        return NULL;
+    return card_locations.at(card_id).owner;
 }
 
 Player::Place Room::getCardPlace(int card_id) const{
-    if(card_id < 0)
+    if(card_id < 0 || card_id >= card_locations.size())
         return Player::PlaceUnknown;
-    return place_map.value(card_id);
+    return card_locations.at(card_id).place;
 }
 
 ServerPlayer *Room::getLord() const{
@@ -4486,6 +4667,12 @@ void Room::networkDelayTestCommand(ServerPlayer *player, const QString &){
     speakCommand(player, reportStr.toUtf8().toBase64());
 }
 
+void Room::binaryPacketCommand(ServerPlayer *player, const QString &){
+    // only clients that saw the "P" flag in our setup string send this
+    if(Config.EnableBinaryPacket)
+        player->setBinaryPacket(true);
+}
+
 bool Room::isVirtual()
 {
     return _virtual;
@@ -4524,23 +4711,25 @@ void Room::copyFrom(Room* rRoom)
     }
     current = player_map.value(rRoom->getCurrent());
 
-    pile1 = QList<int> (rRoom->pile1);
-    pile2 = QList<int> (rRoom->pile2);
-    pile3 = QList<int> (rRoom->pile3);
-    pile4 = QList<int> (rRoom->pile4);
-    table_cards = QList<int> (rRoom->table_cards);
+    // the source room may have swapped its draw and discard piles
+    pile1 = *rRoom->draw_pile;
+    pile2 = *rRoom->discard_pile;
+    pile3 = *rRoom->deal_pile;
+    pile4 = *rRoom->top_drawpile;
+    table_cards = rRoom->table_cards;
     draw_pile = &pile1;
     discard_pile = &pile2;
     deal_pile = &pile3;
     top_drawpile = &pile4;
 
-    place_map = QMap<int, Player::Place> (rRoom->place_map);
-    owner_map = QMap<int, ServerPlayer*>();
-
-    QList<int> keys = rRoom->owner_map.keys();
-
-    foreach(int i, keys)
-        owner_map.insert(i, rRoom->owner_map.value(i));
+    // the location table is plain data, so this is one block copy
+    // followed by pointing the owners at our own players
+    card_locations = rRoom->card_locations;
+    for(int i = 0; i < card_locations.size(); i++){
+        CardLocation &location = card_locations[i];
+        if(location.owner)
+            location.owner = player_map.value(location.owner);
+    }
 
     provided = rRoom->provided;
     has_provided = rRoom->has_provided;
@@ -4611,6 +4800,48 @@ void Room::monitor_timerTrigger()
     }
 }
 
+Room *Room::GetCurrentRoom()
+{
+    QThread *current = QThread::currentThread();
+    RoomThread *room_thread = qobject_cast<RoomThread *>(current);
+    if(room_thread)
+        return room_thread->getRoom();
+
+    // general selection of 3v3 and 1v1 runs in threads of its own
+    RoomThread3v3 *thread_3v3 = qobject_cast<RoomThread3v3 *>(current);
+    if(thread_3v3)
+        return thread_3v3->getRoom();
+
+    RoomThread1v1 *thread_1v1 = qobject_cast<RoomThread1v1 *>(current);
+    if(thread_1v1)
+        return thread_1v1->getRoom();
+
+    return qobject_cast<Room *>(current);
+}
+
+void Room::adoptVirtualCard(const Card *card)
+{
+    if(card->isVirtualCard())
+        virtual_cards << card;
+}
+
+void Room::forgetVirtualCard(const Card *card)
+{
+    if(!virtual_cards.remove(card))
+        retired_virtual_cards.remove(card);
+}
+
+void Room::releaseVirtualCards()
+{
+    // the cards are deleted from a copy, since their destructors forget them
+    QSet<const Card *> cards = retired_virtual_cards;
+    retired_virtual_cards = virtual_cards;
+    virtual_cards.clear();
+
+    foreach(const Card *card, cards)
+        delete card;
+}
+
 void Room::releaseSource()
 {
     if(QThread::currentThread() == thread)
@@ -4619,6 +4850,25 @@ void Room::releaseSource()
         sem->release();
 }
 
+void Room::recycleLuaState()
+{
+    // finished() is emitted right before the thread really stops
+    QThread *finished_thread = qobject_cast<QThread *>(sender());
+    if(finished_thread)
+        finished_thread->wait();
+
+    if(L == NULL || isRunning())
+        return;
+
+    if(thread && thread->isRunning()){
+        connect(thread, SIGNAL(finished()), this, SLOT(recycleLuaState()), Qt::UniqueConnection);
+        return;
+    }
+
+    LuaStatePool::GetInstance()->recycle(L);
+    L = NULL;
+}
+
 void Room::Ready_timerTrigger()
 {
     if(!isFull()){
@@ -14,7 +14,13 @@ struct LogMessage;
 #include "serverplayer.h"
 #include "roomthread.h"
 #include "protocol.h"
+#include "cardpile.h"
+#include "distancematrix.h"
+#include "relationtable.h"
+#include "gamestate.h"
 #include <qmutex.h>
+#include <QSet>
+#include <QAtomicInt>
 
 class Room : public QThread{
     Q_OBJECT
@@ -27,8 +33,10 @@ public:
     typedef void (Room::*Callback)(ServerPlayer *, const QString &);
     typedef bool (Room::*CallBack)(ServerPlayer *, const QSanProtocol::QSanGeneralPacket*);
     typedef bool (Room::*ResponseVerifyFunction)(ServerPlayer*, const Json::Value&, void*);
+    typedef void (Room::*ResponseCallback)(ServerPlayer*, void*);
 
     explicit Room(QObject *parent, const QString &mode);
+    ~Room();
     ServerPlayer *addSocket(ClientSocket *socket);
     inline int getId() const { return _m_Id; }
     bool isFull() const;
@@ -126,9 +134,14 @@ public:
     // @param timeOut
     //        Maximum total milliseconds that server will wait for all clients to respond before returning. Any client
     //        response after the timeOut will be rejected.
+    // @param callback
+    //        Optional function called on the room thread for each player as soon as that player's request completes,
+    //        i.e. in the order replies arrive. Players who time out are passed to it when the wait is over.
     // @return True if the a valid response is returned from client.
-    bool doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command, time_t timeOut);
-    bool doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command);
+    bool doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command, time_t timeOut,
+                            ResponseCallback callback = NULL, void *callbackArg = NULL);
+    bool doBroadcastRequest(QList<ServerPlayer*> &players, QSanProtocol::CommandType command,
+                            ResponseCallback callback = NULL, void *callbackArg = NULL);
 
     // Broadcast a request to a list of players and get the first valid client response. Call is blocking until the first
     // client response is received or server times out, whichever is earlier. Any client response is verified by the validation
@@ -198,10 +211,10 @@ public:
     void acquireSkill(ServerPlayer *player, const QString &skill_name, bool open = true, bool doAnimation = true);
     void adjustSeats();
     void swapPile();
-    QList<int> getDiscardPile();
-    QList<int> getDrawPile();
-    QList<int> getDealingArea();
-    QList<int> getTopDrawPile();
+    QList<int> getDiscardPile() const;
+    QList<int> getDrawPile() const;
+    QList<int> getDealingArea() const;
+    QList<int> getTopDrawPile() const;
     int getCardFromPile(const QString &card_name);
     QList<ServerPlayer *> findPlayersBySkillName(const QString &skill_name, bool include_dead = false) const;
     ServerPlayer *findPlayer(const QString &general_name, bool include_dead = false) const;
@@ -212,6 +225,8 @@ public:
     void swapSeat(ServerPlayer *a, ServerPlayer *b);
     lua_State *getLuaState() const;
     void setFixedDistance(Player *from, const Player *to, int distance);
+    DistanceMatrix *getDistanceMatrix();
+    RelationTable *getRelationTable();
     void reverseFor3v3(const Card *card, ServerPlayer *player, QList<ServerPlayer *> &list);
     bool hasWelfare(const ServerPlayer *player) const;
     ServerPlayer *getFront(ServerPlayer *a, ServerPlayer *b) const;
@@ -294,6 +309,7 @@ public:
     void broadcastInvoke(const char *method, const QString &arg = ".", ServerPlayer *except = NULL);
     void startTest(const QString &to_test);
     void networkDelayTestCommand(ServerPlayer *player, const QString &);
+    void binaryPacketCommand(ServerPlayer *player, const QString &);
 
     void setGerenalGender(const QString &name, const QString &gender);
 
@@ -335,12 +351,13 @@ private:
     void _fillMoveInfo(CardsMoveStruct &moves, int card_index) const;
     QString _chooseDefaultGeneral(ServerPlayer* player) const;
     bool _setPlayerGeneral(ServerPlayer* player, const QString& generalName, bool isFirst);
+    void _setChosenGeneral(ServerPlayer* player, void *isFirst);
     QString mode;
     int player_count;
     ServerPlayer *current;
-    QList<int> pile1, pile2, pile3, pile4;
-    QList<int> table_cards;
-    QList<int> *draw_pile, *discard_pile, *deal_pile, *top_drawpile;
+    CardPile pile1, pile2, pile3, pile4;
+    CardPile table_cards;
+    CardPile *draw_pile, *discard_pile, *deal_pile, *top_drawpile;
     /* @todo: modify this
     QMap<> _m_tablePiles;
     QList getTablePile(const QString &pile_name); */
@@ -359,16 +376,66 @@ public:
     int getDrawPileCount();
     void releaseSource();
 
+    // the room whose game runs in the calling thread, or NULL
+    static Room *GetCurrentRoom();
+
+    // virtual cards parsed in the room thread are kept for the turn they were
+    // parsed in and the next one; the room thread releases the older
+    // generation after every turn. No holder outlives that: delayed tricks
+    // and piles keep card ids, the room tags that keep cards are only read
+    // while the effect that set them runs, and the Lua AI only keeps parsed
+    // cards in locals and in self.toUse, cleared by activate
+    void adoptVirtualCard(const Card *card);
+    void forgetVirtualCard(const Card *card);
+    void releaseVirtualCards();
+
+    // all outgoing traffic is encoded through these, once per message and
+    // format, so the counters below cover everything the room has sent
+    QByteArray serializePacket(const QSanProtocol::QSanPacket *packet, bool binary);
+    QByteArray serializeMessage(const QString &message);
+    int getSerializedCount() const;
+    int getSerializedBytes() const;
+
+    // card moves notified, and the distinct payloads built for them
+    int getMoveNotifyCount() const;
+    int getMovePayloadCount() const;
+
+    // milliseconds the room thread spent parked on replies and delays
+    void addWaitTime(int msecs);
+    int getWaitTime() const;
+
+    // the game is only read in the room thread: requestSnapshot asks it to
+    // take a GameState before its next event and hand it out by snapshot_taken
+    void requestSnapshot();
+    void takeRequestedSnapshot();
+
+public slots:
+    // hand the Lua state back to LuaStatePool once no room thread uses it
+    void recycleLuaState();
+
 private:
     lua_State *L;
     QList<AI *> ais;
 
+    QSet<const Card *> virtual_cards, retired_virtual_cards;
+
+    QAtomicInt _m_serializedCount;
+    QAtomicInt _m_serializedBytes;
+    QAtomicInt _m_moveNotifyCount;
+    QAtomicInt _m_movePayloadCount;
+    QAtomicInt _m_waitTime;
+    QAtomicInt _m_snapshotRequested;
+
+    DistanceMatrix distance_matrix;
+    RelationTable relation_table;
+
     RoomThread *thread;
     RoomThread3v3 *thread_3v3;
     RoomThread1v1 *thread_1v1;
     QSemaphore *sem; // Legacy semaphore, expected to be reomved after new synchronization is fully deployed.
     QSemaphore _m_semRaceRequest; // When race starts, server waits on his semaphore for the first replier
     QSemaphore _m_semRoomMutex; // Provide per-room  (rather than per-player) level protection of any shared variables
+    QSemaphore _m_semBroadcastReply; // Released whenever a player of the current broadcast request completes
 
 
     QHash<QString, Callback> callbacks; // Legacy protocol callbacks
@@ -384,8 +451,11 @@ private:
     bool _m_raceStarted;
     ServerPlayer* _m_raceWinner;
 
-    QMap<int, Player::Place> place_map;
-    QMap<int, ServerPlayer*> owner_map;
+    struct CardLocation{
+        Player::Place place;
+        ServerPlayer *owner;
+    };
+    QVector<CardLocation> card_locations; // indexed by card id, see setCardMapping
 
     const Card *provided;
     bool has_provided;
@@ -401,6 +471,7 @@ private:
     void chooseGenerals();
     AI *cloneAI(ServerPlayer *player);
     void broadcast(const QString &message, ServerPlayer *except = NULL);
+    void broadcastPacket(const QList<ServerPlayer *> &players, const QSanProtocol::QSanPacket *packet, ServerPlayer *except = NULL);
     void initCallbacks();
     void arrangeCommand(ServerPlayer *player, const QString &arg);
     void takeGeneralCommand(ServerPlayer *player, const QString &arg);
@@ -443,6 +514,7 @@ signals:
     void game_over(const QString &winner);
     void room_finished();
     void ready_for_disconnect();
+    void snapshot_taken(const GameState &state);
 };
 
 typedef Room *RoomStar;
@@ -0,0 +1,190 @@
+#include "roomscheduler.h"
+#include "room.h"
+
+#include <QThread>
+#include <QMutexLocker>
+
+RoomScheduler::RoomScheduler()
+    :capacity(0), stack_size(0), running(0), parked(0), waiting(0), handoffs(0),
+      park_times(0), parked_time(0), slot_wait_time(0)
+{
+    setCapacity(-1);
+}
+
+RoomScheduler *RoomScheduler::GetInstance(){
+    static RoomScheduler *scheduler;
+    if(scheduler == NULL)
+        scheduler = new RoomScheduler;
+
+    return scheduler;
+}
+
+void RoomScheduler::setCapacity(int capacity){
+    QMutexLocker locker(&mutex);
+    if(capacity == 0)
+        capacity = qMax(QThread::idealThreadCount(), 1);
+    this->capacity = capacity;
+    wait_condition.wakeAll();
+}
+
+int RoomScheduler::getCapacity() const{
+    QMutexLocker locker(&mutex);
+    return capacity;
+}
+
+void RoomScheduler::setStackSize(int kilobytes){
+    QMutexLocker locker(&mutex);
+    stack_size = qMax(kilobytes, 0);
+}
+
+void RoomScheduler::prepareThread(QThread *thread) const{
+    QMutexLocker locker(&mutex);
+    if(stack_size > 0)
+        thread->setStackSize(stack_size * 1024);
+}
+
+int RoomScheduler::getRunningCount() const{
+    QMutexLocker locker(&mutex);
+    return running;
+}
+
+int RoomScheduler::getParkedCount() const{
+    QMutexLocker locker(&mutex);
+    return parked;
+}
+
+int RoomScheduler::getWaitingCount() const{
+    QMutexLocker locker(&mutex);
+    return waiting;
+}
+
+qint64 RoomScheduler::getParkTimes() const{
+    QMutexLocker locker(&mutex);
+    return park_times;
+}
+
+qint64 RoomScheduler::getParkedTime() const{
+    QMutexLocker locker(&mutex);
+    return parked_time;
+}
+
+qint64 RoomScheduler::getSlotWaitTime() const{
+    QMutexLocker locker(&mutex);
+    return slot_wait_time;
+}
+
+void RoomScheduler::enter(bool yielding){
+    QMutexLocker locker(&mutex);
+    if(handoffs == 0 && (capacity <= 0 || running < capacity)){
+        running++;
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if(yielding){
+        // queue behind the room the slot was handed to
+        while(handoffs > 0 || (capacity > 0 && running >= capacity))
+            wait_condition.wait(&mutex);
+    }else{
+        waiting++;
+        while(handoffs == 0 && capacity > 0 && running >= capacity)
+            wait_condition.wait(&mutex);
+        if(handoffs > 0)
+            handoffs--;
+        waiting--;
+    }
+    running++;
+
+    slot_wait_time += timer.elapsed();
+    wait_condition.wakeAll();
+}
+
+void RoomScheduler::yield(){
+    if(!holding.hasLocalData() || holding.localData()->depth <= 0)
+        return;
+
+    {
+        QMutexLocker locker(&mutex);
+        if(waiting <= handoffs)
+            return;
+
+        handoffs++;
+        running--;
+        wait_condition.wakeAll();
+    }
+
+    enter(true);
+}
+
+void RoomScheduler::leave(){
+    QMutexLocker locker(&mutex);
+    running--;
+    wait_condition.wakeOne();
+}
+
+bool RoomScheduler::park(){
+    // only threads running under a Slot take part, and only once
+    if(!holding.hasLocalData() || holding.localData()->depth <= 0)
+        return false;
+
+    ThreadState *state = holding.localData();
+    state->depth = -state->depth;
+    leave();
+
+    QMutexLocker locker(&mutex);
+    parked++;
+    park_times++;
+    return true;
+}
+
+void RoomScheduler::resume(qint64 parked_msecs){
+    mutex.lock();
+    parked--;
+    parked_time += parked_msecs;
+    mutex.unlock();
+
+    enter();
+
+    ThreadState *state = holding.localData();
+    state->depth = -state->depth;
+    if(state->room)
+        state->room->addWaitTime(parked_msecs);
+}
+
+RoomScheduler::Slot::Slot(Room *room){
+    RoomScheduler *scheduler = GetInstance();
+    if(!scheduler->holding.hasLocalData()){
+        ThreadState *state = new ThreadState;
+        state->depth = 0;
+        state->room = NULL;
+        scheduler->holding.setLocalData(state);
+    }
+
+    ThreadState *state = scheduler->holding.localData();
+    if(state->depth++ == 0){
+        state->room = room;
+        scheduler->enter();
+    }
+}
+
+RoomScheduler::Slot::~Slot(){
+    RoomScheduler *scheduler = GetInstance();
+    ThreadState *state = scheduler->holding.localData();
+    if(--state->depth == 0){
+        state->room = NULL;
+        scheduler->leave();
+    }
+}
+
+RoomScheduler::Parking::Parking(){
+    parked = GetInstance()->park();
+    if(parked)
+        timer.start();
+}
+
+RoomScheduler::Parking::~Parking(){
+    if(parked)
+        GetInstance()->resume(timer.elapsed());
+}
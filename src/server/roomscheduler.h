@@ -0,0 +1,83 @@
+#ifndef ROOMSCHEDULER_H
+#define ROOMSCHEDULER_H
+
+class QThread;
+class Room;
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadStorage>
+#include <QElapsedTimer>
+
+// Lets at most `capacity` room threads run game logic at the same time.
+// A room thread holds a slot while it computes and parks, giving the slot
+// back, while it waits for a client reply or a delay. It is off by default:
+// every room still has its own threads, so the gate only trades latency of
+// rooms woken by a reply for less contention when many AI rooms compute.
+// Enable it with -workers:N (0 for one slot per core).
+class RoomScheduler
+{
+public:
+    static RoomScheduler *GetInstance();
+
+    // 0 means one slot per core, a negative capacity disables the limit
+    void setCapacity(int capacity);
+    int getCapacity() const;
+
+    // stack size in KB for room threads, 0 keeps the system default
+    void setStackSize(int kilobytes);
+    void prepareThread(QThread *thread) const;
+
+    int getRunningCount() const;
+    int getParkedCount() const;
+    int getWaitingCount() const;
+    qint64 getParkTimes() const;
+    qint64 getParkedTime() const;
+    qint64 getSlotWaitTime() const;
+
+    // held for the whole run() of a room thread,
+    // the time it spends parked is added to the room's wait time
+    class Slot{
+    public:
+        explicit Slot(Room *room);
+        ~Slot();
+    };
+
+    // called by a room thread between two turns: if other rooms are waiting
+    // for a slot, one of them takes over this one and the caller queues again,
+    // so a room that never waits on a client cannot keep its slot for a game
+    void yield();
+
+    // put around a blocking wait inside a room thread, does nothing elsewhere
+    class Parking{
+    public:
+        Parking();
+        ~Parking();
+
+    private:
+        bool parked;
+        QElapsedTimer timer;
+    };
+
+private:
+    RoomScheduler();
+
+    struct ThreadState{
+        int depth; // negated while parked
+        Room *room;
+    };
+
+    void enter(bool yielding = false);
+    void leave();
+    bool park();
+    void resume(qint64 parked_msecs);
+
+    mutable QMutex mutex;
+    QWaitCondition wait_condition;
+    QThreadStorage<ThreadState *> holding;
+    int capacity, stack_size;
+    int running, parked, waiting, handoffs;
+    qint64 park_times, parked_time, slot_wait_time;
+};
+
+#endif // ROOMSCHEDULER_H
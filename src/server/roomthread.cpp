@@ -7,8 +7,10 @@
 #include "ai.h"
 #include "jsonutils.h"
 #include "settings.h"
+#include "roomscheduler.h"
 
 #include <QTime>
+#include <QElapsedTimer>
 #include <json/json.h>
 
 using namespace QSanProtocol::Utils;
@@ -188,10 +190,26 @@ QString EventTriplet::toString() const{
 //@todo: setParent here is illegitimate in QT and is equivalent to calling
 // setParent(NULL). Find another way to do it if we really need a parent.
 RoomThread::RoomThread(Room *room)
-    :room(room)
+    :mutex(QMutex::Recursive), room(room), ai_wait_time(0), ai_filter_count(0), trigger_count(0)
 {
 }
 
+Room *RoomThread::getRoom() const{
+    return room;
+}
+
+qint64 RoomThread::getAIWaitTime() const{
+    return ai_wait_time;
+}
+
+int RoomThread::getAIFilterCount() const{
+    return ai_filter_count;
+}
+
+int RoomThread::getTriggerCount() const{
+    return trigger_count;
+}
+
 void RoomThread::addPlayerSkills(ServerPlayer *player, bool invoke_game_start){
     bool invokeStart = false;
 
@@ -283,6 +301,8 @@ void RoomThread::action3v3(ServerPlayer *player){
 }
 
 void RoomThread::run(){
+    RoomScheduler::Slot slot(room);
+
     qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
 
     GameRule *game_rule;
@@ -388,39 +408,63 @@ static bool CompareByPriority(const TriggerSkill *a, const TriggerSkill *b){
 
 bool RoomThread::trigger(TriggerEvent event, Room *room, ServerPlayer *target, QVariant &data){
     //Q_ASSERT(QThread::currentThread() == this);
+    trigger_count.fetchAndAddRelaxed(1);
+    room->takeRequestedSnapshot();
 
     // push it to event stack
     EventTriplet triplet(event, room, target, &data);
     event_stack.push_back(triplet);
 
+    // the global skills as registered when the event started, as the old table
+    // was copied by foreach; the owned ones are looked up again after every
+    // handler, since a handler may give the target a skill that is still to come
+    QList<const TriggerSkill *> globals = global_table[event];
+    QList<const TriggerSkill *> owned = getOwnedSkills(event, target);
+
     bool broken = false;
-    foreach(const TriggerSkill *skill, skill_table[event]){
+    int i = 0, j = 0;
+    while(i < globals.length() || j < owned.length()){
+        const TriggerSkill *skill;
+        if(j == owned.length() || (i < globals.length() && triggersBefore(globals.at(i), owned.at(j))))
+            skill = globals.at(i++);
+        else
+            skill = owned.at(j++);
+
         if(skill->triggerable(target)){
             broken = skill->trigger(event, room, target, data);
             if(broken)
                 break;
+
+            owned = getOwnedSkills(event, target);
+            j = 0;
+            while(j < owned.length() && !triggersBefore(skill, owned.at(j)))
+                j++;
         }
     }
 
-    if(target){
-        foreach(AI *ai, room->ais){
-            mutex.lock();
-            while(!Sanguosha->getAIState()){ // AI FREE?
-                msleep(30);
-            }
-            Sanguosha->setAIState(false);
-            mutex.unlock();
+    if(target && !room->ais.isEmpty()){
+        // every room owns its own lua_State, so only AIs of this room
+        // have to be serialized against each other
+        QElapsedTimer timer;
+        timer.start();
 
+        QMutexLocker locker(&mutex);
+        foreach(AI *ai, room->ais)
             ai->filterEvent(event, target, data); // 20120321 by highlandz
-            mutex.lock();
-            Sanguosha->setAIState(true);
-            mutex.unlock();
-        }
+
+        ai_wait_time += timer.elapsed();
+        ai_filter_count++;
     }
 
     // pop event stack
     event_stack.pop_back();
 
+    // a whole turn is over unless it is an extra turn inside another event
+    if(event == TurnStart && event_stack.isEmpty()){
+        room->releaseVirtualCards();
+        RoomScheduler::GetInstance()->yield();
+    }
+
     return broken;
 }
 
@@ -433,18 +477,64 @@ bool RoomThread::trigger(TriggerEvent event, Room *room, ServerPlayer *target){
     return trigger(event, room, target, data);
 }
 
+bool RoomThread::triggersBefore(const TriggerSkill *a, const TriggerSkill *b) const{
+    if(a->getPriority() != b->getPriority())
+        return a->getPriority() > b->getPriority();
+    if(a->secondPriority() != b->secondPriority())
+        return a->secondPriority() > b->secondPriority();
+    return skill_order.value(a) < skill_order.value(b);
+}
+
+static void CollectOwnedSkills(const QMultiHash<QString, const TriggerSkill *> &owners, const QSet<QString> &names,
+                               QList<const TriggerSkill *> &skills){
+    foreach(QString name, names){
+        QMultiHash<QString, const TriggerSkill *>::const_iterator it = owners.find(name);
+        while(it != owners.end() && it.key() == name){
+            if(!skills.contains(it.value()))
+                skills << it.value();
+            ++it;
+        }
+    }
+}
+
+// a skill that is not global never triggers on a player who does not own it
+QList<const TriggerSkill *> RoomThread::getOwnedSkills(TriggerEvent event, const ServerPlayer *target) const{
+    const QMultiHash<QString, const TriggerSkill *> &owners = owner_table[event];
+
+    QList<const TriggerSkill *> skills;
+    if(target == NULL || owners.isEmpty())
+        return skills;
+
+    if(target->getGeneral())
+        CollectOwnedSkills(owners, target->getGeneral()->getSkillNames(), skills);
+    if(target->getGeneral2())
+        CollectOwnedSkills(owners, target->getGeneral2()->getSkillNames(), skills);
+    CollectOwnedSkills(owners, target->getAcquiredSkills(), skills);
+
+    // insertion sort, a player owns a handful of skills for one event at most
+    for(int i = 1; i < skills.length(); i++){
+        for(int k = i; k > 0 && triggersBefore(skills.at(k), skills.at(k - 1)); k--)
+            skills.swap(k, k - 1);
+    }
+
+    return skills;
+}
+
 void RoomThread::addTriggerSkill(const TriggerSkill *skill){
-    if(skillSet.contains(skill))
+    if(skill_order.contains(skill))
         return;
 
-    skillSet << skill;
+    skill_order.insert(skill, skill_order.size());
 
     QList<TriggerEvent> events = skill->getTriggerEvents();
     foreach(TriggerEvent event, events){
-        QList<const TriggerSkill *> &table = skill_table[event];
-
-        table << skill;
-        qStableSort(table.begin(), table.end(), CompareByPriority);
+        if(skill->isGlobal()){
+            // behind every skill of the same priority, just as a stable sort would put it
+            QList<const TriggerSkill *> &table = global_table[event];
+            QList<const TriggerSkill *>::iterator pos = qUpperBound(table.begin(), table.end(), skill, CompareByPriority);
+            table.insert(pos, skill);
+        }else
+            owner_table[event].insert(skill->objectName(), skill);
     }
 
     if(skill->isVisible()){
@@ -459,6 +549,8 @@ void RoomThread::addTriggerSkill(const TriggerSkill *skill){
 }
 
 void RoomThread::delay(unsigned long secs){
-    if(room->property("to_test").toString().isEmpty()&& Config.AIDelay>0)
+    if(room->property("to_test").toString().isEmpty()&& Config.AIDelay>0){
+        RoomScheduler::Parking parking;
         msleep(secs);
+    }
 }
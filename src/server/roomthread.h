@@ -5,6 +5,8 @@
 #include <QSemaphore>
 #include <QVariant>
 #include <QMutex>
+#include <QMultiHash>
+#include <QAtomicInt>
 
 #include <csetjmp>
 
@@ -40,6 +42,7 @@ class RoomThread : public QThread{
 
 public:
     explicit RoomThread(Room *room);
+    Room *getRoom() const;
     void constructTriggerTable();
     bool trigger(TriggerEvent event, Room* room, ServerPlayer *target, QVariant &data);
     bool trigger(TriggerEvent event, Room* room, ServerPlayer *target);
@@ -53,7 +56,14 @@ public:
 
     const QList<EventTriplet> *getEventStack() const;
 
-    // QReadWriteLock rwlock;
+    // total milliseconds triggers spent on AI event filtering, and how many times
+    qint64 getAIWaitTime() const;
+    int getAIFilterCount() const;
+
+    // how many events have been triggered in this room
+    int getTriggerCount() const;
+
+    // guards the room's own lua_State while AIs filter events
     QMutex mutex;
 
 protected:
@@ -64,10 +74,21 @@ private:
     jmp_buf env;
     QString order;
 
-    QList<const TriggerSkill *> skill_table[NumOfEvents];
-    QSet<const TriggerSkill *> skillSet;
+    // the global skills of every event in priority order, and the others by owner,
+    // so a trigger only visits global skills and skills the target owns;
+    // skill_order breaks priority ties by registration, as the old sorted table did
+    QList<const TriggerSkill *> global_table[NumOfEvents];
+    QMultiHash<QString, const TriggerSkill *> owner_table[NumOfEvents];
+    QHash<const TriggerSkill *, int> skill_order;
 
     QList<EventTriplet> event_stack;
+
+    qint64 ai_wait_time;
+    int ai_filter_count;
+    QAtomicInt trigger_count;
+
+    bool triggersBefore(const TriggerSkill *a, const TriggerSkill *b) const;
+    QList<const TriggerSkill *> getOwnedSkills(TriggerEvent event, const ServerPlayer *target) const;
 };
 
 #endif // ROOMTHREAD_H
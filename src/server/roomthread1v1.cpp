@@ -3,6 +3,7 @@
 #include "engine.h"
 #include "settings.h"
 #include "generalselector.h"
+#include "roomscheduler.h"
 
 #include <QDateTime>
 
@@ -12,7 +13,12 @@ RoomThread1v1::RoomThread1v1(Room *room)
     :room(room)
 {}
 
+Room *RoomThread1v1::getRoom() const{
+    return room;
+}
+
 void RoomThread1v1::run(){
+    RoomScheduler::Slot slot(room);
 
     // initialize the random seed for this thread
     qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
@@ -47,6 +53,7 @@ void RoomThread1v1::run(){
     startArrange(first);
     startArrange(next);
 
+    RoomScheduler::Parking parking;
     room->sem->acquire(2);
 }
 
@@ -62,10 +69,14 @@ void RoomThread1v1::askForTakeGeneral(ServerPlayer *player){
     if(name.isNull()){
         player->invoke("askForGeneral1v1");
     }else{
-        msleep(1000);
+        {
+            RoomScheduler::Parking parking;
+            msleep(1000);
+        }
         takeGeneral(player, name);
     }
 
+    RoomScheduler::Parking parking;
     room->sem->acquire();
 }
 
@@ -13,6 +13,7 @@ class RoomThread1v1 : public QThread
 
 public:
     explicit RoomThread1v1(Room *room);
+    Room *getRoom() const;
     void takeGeneral(ServerPlayer *player, const QString &name);
     void arrange(ServerPlayer *player, const QStringList &arranged);
 
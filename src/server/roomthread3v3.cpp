@@ -5,6 +5,7 @@
 #include "lua.hpp"
 #include "settings.h"
 #include "generalselector.h"
+#include "roomscheduler.h"
 
 #include <QDateTime>
 
@@ -14,6 +15,10 @@ RoomThread3v3::RoomThread3v3(Room *room)
     :room(room)
 {}
 
+Room *RoomThread3v3::getRoom() const{
+    return room;
+}
+
 QStringList RoomThread3v3::getGeneralsWithoutExtension() const{
     QList<const General *> generals;
 
@@ -53,6 +58,8 @@ QStringList RoomThread3v3::getGeneralsWithoutExtension() const{
 
 void RoomThread3v3::run()
 {
+    RoomScheduler::Slot slot(room);
+
     // initialize the random seed for this thread
     qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
 
@@ -103,6 +110,7 @@ void RoomThread3v3::run()
     startArrange(first);
     startArrange(next);
 
+    RoomScheduler::Parking parking;
     room->sem->acquire(2);
 }
 
@@ -114,10 +122,14 @@ void RoomThread3v3::askForTakeGeneral(ServerPlayer *player){
     if(name.isNull()){
         player->invoke("askForGeneral3v3");
     }else{
-        msleep(1000);
+        {
+            RoomScheduler::Parking parking;
+            msleep(1000);
+        }
         takeGeneral(player, name);
     }
 
+    RoomScheduler::Parking parking;
     room->sem->acquire();
 }
 
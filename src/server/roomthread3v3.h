@@ -14,6 +14,7 @@ class RoomThread3v3 : public QThread
 
 public:
     explicit RoomThread3v3(Room *room);
+    Room *getRoom() const;
     void takeGeneral(ServerPlayer *player, const QString &name);
     void arrange(ServerPlayer *player, const QStringList &arranged);
     void assignRoles(const QString &scheme);
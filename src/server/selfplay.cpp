@@ -0,0 +1,127 @@
+#include "selfplay.h"
+#include "room.h"
+#include "engine.h"
+#include "settings.h"
+#include "luastatepool.h"
+#include "roomscheduler.h"
+#include "jsonutils.h"
+
+#include <QThread>
+#include <QCoreApplication>
+
+using namespace QSanProtocol::Utils;
+
+SelfPlay::SelfPlay(QObject *parent, int games, int jobs, const QString &filename)
+    :QObject(parent), games(games), jobs(jobs), started(0), finished(0), output(filename)
+{
+    if(this->jobs <= 0)
+        this->jobs = qMax(QThread::idealThreadCount(), 1);
+}
+
+bool SelfPlay::start(){
+    if(!output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+
+    // robots only, nothing to wait for
+    Config.AIDelay = 0;
+    Config.CountDownSeconds = 0;
+    Config.ContestMode = false;
+    Config.EnableAI = true;
+    ServerInfo.parse(Sanguosha->getSetupString());
+
+    LuaStatePool::GetInstance()->setCapacity(jobs);
+    RoomScheduler::GetInstance()->setCapacity(Config.RoomWorkers);
+    RoomScheduler::GetInstance()->setStackSize(Config.RoomStackSize);
+
+    printf("Self play: %d games of mode %s on %d workers\n", games, qPrintable(Config.GameMode), jobs);
+    watch.start();
+
+    for(int i = 0; i < jobs && started < games; i++)
+        startGame();
+
+    return true;
+}
+
+void SelfPlay::startGame(){
+    Room *room = new Room(this, Config.GameMode);
+    started++;
+
+    // game_over is emitted from the room thread right before it throws
+    // GameFinished, so the players are still intact when it is recorded
+    connect(room, SIGNAL(game_over(QString)), this, SLOT(recordGame(QString)), Qt::DirectConnection);
+
+    mutex.lock();
+    start_times.insert(room, watch.elapsed());
+    mutex.unlock();
+
+    // every robot toggles ready, the last one starts the room
+    room->fillRobotsCommand(NULL, QString());
+}
+
+void SelfPlay::recordGame(const QString &winner){
+    Room *room = qobject_cast<Room *>(sender());
+    QStringList winners = winner.split("+");
+
+    Json::Value line(Json::objectValue);
+    line["mode"] = toJsonString(room->getMode());
+    line["winner"] = toJsonString(winner);
+
+    Json::Value players(Json::arrayValue);
+    foreach(ServerPlayer *player, room->getPlayers()){
+        Json::Value item(Json::objectValue);
+        item["seat"] = player->getSeat();
+        item["general"] = toJsonString(player->getGeneralName());
+        if(player->getGeneral2())
+            item["general2"] = toJsonString(player->getGeneral2Name());
+        item["role"] = toJsonString(player->getRole());
+        item["alive"] = player->isAlive();
+        item["win"] = winners.contains(player->getRole()) || winners.contains(player->objectName());
+        players.append(item);
+    }
+    line["players"] = players;
+
+    QMutexLocker locker(&mutex);
+    line["game"] = finished + 1;
+    line["msecs"] = (int)(watch.elapsed() - start_times.take(room));
+    output.write(Json::FastWriter().write(line).c_str());
+    finished++;
+    over_rooms << room;
+
+    QMetaObject::invokeMethod(this, "cleanupRooms", Qt::QueuedConnection);
+}
+
+void SelfPlay::cleanupRooms(){
+    mutex.lock();
+    QList<Room *> rooms = over_rooms;
+    over_rooms.clear();
+    mutex.unlock();
+
+    foreach(Room *room, rooms){
+        // the room thread returns right after game_over
+        RoomThread *thread = room->getThread();
+        if(thread)
+            thread->wait();
+        room->wait();
+
+        room->recycleLuaState();
+        if(thread)
+            thread->deleteLater();
+        room->deleteLater();
+
+        if(started < games)
+            startGame();
+    }
+
+    QMutexLocker locker(&mutex);
+    if(finished < games || !over_rooms.isEmpty() || !output.isOpen())
+        return;
+
+    output.close();
+    locker.unlock();
+
+    double secs = watch.elapsed() / 1000.0;
+    printf("Self play: %d games in %.1f seconds, %.1f games per minute\n",
+           finished, secs, secs > 0 ? finished * 60.0 / secs : 0.0);
+
+    emit all_finished();
+}
@@ -0,0 +1,41 @@
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+class Room;
+
+#include <QObject>
+#include <QFile>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QHash>
+
+// Headless batch mode for "-server -selfplay:N". Plays N robot-only games,
+// at most `jobs` rooms at a time, and writes one JSON line per finished game.
+class SelfPlay : public QObject
+{
+    Q_OBJECT
+
+public:
+    SelfPlay(QObject *parent, int games, int jobs, const QString &filename);
+    bool start();
+
+private:
+    int games, jobs;
+    int started, finished;
+    QFile output;
+    QMutex mutex;
+    QElapsedTimer watch;
+    QHash<Room *, qint64> start_times;
+    QList<Room *> over_rooms;
+
+    void startGame();
+
+private slots:
+    void recordGame(const QString &winner);
+    void cleanupRooms();
+
+signals:
+    void all_finished();
+};
+
+#endif // SELFPLAY_H
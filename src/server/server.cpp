@@ -8,6 +8,11 @@
 #include "contestdb.h"
 #include "choosegeneraldialog.h"
 #include "customassigndialog.h"
+#include "luastatepool.h"
+#include "roomscheduler.h"
+#include "servermetrics.h"
+#include "gamestate.h"
+#include "atom.h"
 #include "time.h"
 
 #include <QInputDialog>
@@ -24,6 +29,8 @@
 #include <QHttp>
 #include <QAction>
 #include <QTimer>
+#include <QDir>
+#include <QFile>
 
 static QLayout *HLay(QWidget *left, QWidget *right){
     QHBoxLayout *layout = new QHBoxLayout;
@@ -1022,7 +1029,7 @@ bool ServerDialog::config(){
 int Server::TimerCounts=0;
 
 Server::Server(QObject *parent)
-    :QObject(parent)
+    :QObject(parent), lobby_room_count(0), lobby_player_count(0), node_history_changed(false)
 {
     server = new NativeServerSocket;
     server->setParent(this);
@@ -1030,11 +1037,26 @@ Server::Server(QObject *parent)
     //synchronize ServerInfo on the server side to avoid ambiguous usage of Config and ServerInfo
     ServerInfo.parse(Sanguosha->getSetupString());
 
+    LuaStatePool::GetInstance()->setCapacity(Config.LuaStatePoolSize);
+    RoomScheduler::GetInstance()->setCapacity(Config.RoomWorkers);
+    RoomScheduler::GetInstance()->setStackSize(Config.RoomStackSize);
+    ServerMetrics::GetInstance()->start(this);
+    qRegisterMetaType<GameState>("GameState");
     createNewRoom();
 
+    // read once from the engine's Lua state instead of for every signup
+    version = Sanguosha->getVersion();
+    initLobbyHandlers();
+
     connect(server, SIGNAL(new_connection(ClientSocket*)), this, SLOT(processNewConnection(ClientSocket*)));
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(saveNodeHistory()));
     connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(deleteLater()));
 
+    // room lists are answered from this snapshot instead of walking the rooms per request
+    QTimer *lobby_timer = new QTimer(this);
+    connect(lobby_timer, SIGNAL(timeout()), this, SLOT(refreshLobby()));
+    lobby_timer->start(1000);
+
     current = NULL;
 
     if(!Config.Address.isEmpty() && Config.ServerPort){
@@ -1120,384 +1142,298 @@ static inline QString ConvertFromBase64(const QString &base64){
     return QString::fromUtf8(data);
 }
 
-void Server::processRequest(char *request){
+// Only looks at the line itself and the version handed to it.
+// The screen name, always the field after the command, is decoded here.
+static LobbyRequest ParseLobbyRequest(const QByteArray &line, const QString &version){
+    LobbyRequest request;
+    request.line = line;
+
+    QString cmd = request.line.trimmed();
+    request.command = cmd.section(' ', 0, 0);
+
+    QString pattern;
+    int version_field = 0;
+    if(request.command == "signup" || request.command == "signupr")
+        pattern = "(signupr?) (.+):(.+)(:.+)?\n";
+    else if(request.command == "reJoinRoom"){
+        pattern = "(reJoinRoom?) (.+):(.+):(.+):(.+):(.+)?\n";
+        version_field = 5;
+    }else if(request.command == "joinRoom"){
+        pattern = "(joinRoom?) (.+):(.+):(.+):(.+)?\n";
+        version_field = 5;
+    }else if(request.command == "createRoom"){
+        pattern = "(createRoom?) (.+):(.+):(.+)?\n";
+        version_field = 4;
+    }else if(request.command == "refreshRooms" && cmd != "refreshRooms .")
+        pattern = "(refreshRooms?) (.+):(.+)?\n";
+
+    if(pattern.isEmpty()){
+        request.args = cmd.split(" ");
+        return request;
+    }
+
+    QRegExp rx(pattern);
+    if(!rx.exactMatch(request.line)){
+        request.warning = "INVALID_FORMAT";
+        return request;
+    }
+
+    request.args = rx.capturedTexts();
+    request.args[2] = ConvertFromBase64(request.args.at(2));
+    if(version_field != 0 && request.args.at(version_field) != version)
+        request.warning = "INVALID_VERSION";
+
+    return request;
+}
+
+void Server::initLobbyHandlers(){
+    lobby_handlers["signup"] = &Server::handleSignup;
+    lobby_handlers["signupr"] = &Server::handleSignup;
+    lobby_handlers["iamnode"] = &Server::handleNodeAnnouncement;
+    lobby_handlers["nodealive"] = &Server::handleNodeAnnouncement;
+    lobby_handlers["Qnodelist"] = &Server::handleNodeListQuery;
+    lobby_handlers["Qnodeinfo"] = &Server::handleNodeInfoQuery;
+    lobby_handlers["refreshRooms"] = &Server::handleRefreshRooms;
+    lobby_handlers["reJoinRoom"] = &Server::handleReJoinRoom;
+    lobby_handlers["joinRoom"] = &Server::handleJoinRoom;
+    lobby_handlers["createRoom"] = &Server::handleCreateRoom;
+}
 
+void Server::processRequest(char *line){
     ClientSocket *socket = qobject_cast<ClientSocket *>(sender());
     socket->disconnect(this, SLOT(processRequest(char*)));
 
-    QString cmd(request);
-    cmd=cmd.trimmed();
-    if(cmd.indexOf("signup")==-1)
-    {
-        QString msg="";
-        // cmd of HallDialog
-        if(cmd.indexOf("iamnode")!=-1) // new node
-        {
-            QStringList tmplist = cmd.split(" ");
-            if (!nodeList.contains(tmplist[1]))
-            {
-                nodeList.insert(tmplist[1], clock());
-                //emit server_message("Receive and iamnode 0: "+tmplist[1]);
-                Config.HistoryNodeList << tmplist[1];
-                Config.HistoryNodeList.removeDuplicates();
-                Config.HistoryNodeList.sort();
-                Config.setValue("HistoryNodeList", Config.HistoryNodeList);
-            }
-            else if(nodeList[tmplist[1]]!=0)
-            {
-                nodeList.insert(tmplist[1], clock());
-                Config.HistoryNodeList << tmplist[1];
-                Config.HistoryNodeList.removeDuplicates();
-                Config.HistoryNodeList.sort();
-                Config.setValue("HistoryNodeList", Config.HistoryNodeList);
-                //emit server_message("Receive and iamnode 1: "+tmplist[1]);
-            }
+    // parsing a lobby line is a split and a base64 decode, cheaper than
+    // handing it to another thread and back
+    LobbyRequest request = ParseLobbyRequest(QByteArray(line), version);
+    if(!request.warning.isEmpty()){
+        if(request.warning == "INVALID_FORMAT")
+            emit server_message(tr("Invalid %1 string: %2").arg(request.command).arg(request.line));
+        socket->send("warn " + request.warning);
+        socket->disconnectFromHost();
+        return;
+    }
 
-            QHashIterator <QString, long> i(nodeList); // send my nodelist to new node
-            while (i.hasNext()) {
-                i.next();
+    LobbyHandler handler = lobby_handlers.value(request.command);
+    if(handler == NULL){
+        socket->send("warn UNKNOW_" + request.line);
+        socket->disconnectFromHost();
+        return;
+    }
 
-                if(clock()-i.value()>30*1*1000*60 && i.value()!=0)
-                {
-                    nodeList.remove(i.key());
-                    //emit server_message("Remove node: "+i.key());
-                }
-                else
-                {
-                    socket->send("nodelist "+i.key());
-                    //emit server_message("Send nodelist: "+i.key());
-                }
-            }
-            socket->disconnectFromHost();
-            return;
-        }
-        else if(cmd.indexOf("nodealive")!=-1) // received announcement of I am still online
-        {
-            QStringList tmplist = cmd.split(" ");
-            if (!nodeList.contains(tmplist[1])) // a new one
-            {
-                nodeList.insert(tmplist[1], clock());
-                Config.HistoryNodeList << tmplist[1];
-                Config.HistoryNodeList.removeDuplicates();
-                Config.HistoryNodeList.sort();
-                Config.setValue("HistoryNodeList", Config.HistoryNodeList);
-                //emit server_message("Receive nodealive 0: "+tmplist[1]);
-            }
-            else if(nodeList[tmplist[1]]!=0) // update last time
-            {
-                nodeList.insert(tmplist[1], clock());
-                Config.HistoryNodeList << tmplist[1];
-                Config.HistoryNodeList.removeDuplicates();
-                Config.HistoryNodeList.sort();
-                Config.setValue("HistoryNodeList", Config.HistoryNodeList);
-                //emit server_message("Receive nodealive 1: "+tmplist[1]);
-            }
-            else
-            {;}
-            socket->disconnectFromHost();
-            return;
+    (this->*handler)(socket, request);
+}
+
+void Server::refreshLobby(){
+    lobby_rooms.clear();
+    lobby_room_count = 0;
+    lobby_player_count = 0;
+
+    foreach(Room *room, rooms){
+        int playercount = 0;
+        foreach(ServerPlayer *player, room->getPlayers()){
+            if(player->getState() != "robot")
+                playercount++;
         }
-        else if(cmd.indexOf("Qnodelist .")!=-1) // for nodelist request
-        {
-            QHashIterator <QString, long> i(nodeList);
-            while (i.hasNext()) {
-                i.next();
-
-                if(clock()-i.value()>30*1*1000*60 && i.value()!=0)
-                {
-                    nodeList.remove(i.key());
-                    //emit server_message("Qnodelist Remove node: "+i.key());
-                }
-                else
-                {
-                    socket->send("nodelist "+i.key());
-                    //emit server_message("Qnodelist: "+i.key());
-                }
-            }
+        lobby_player_count += playercount;
+
+        // only rooms with an owner are listed
+        QString owner = room->getTag("RoomOwnerScreenName").toString().trimmed();
+        if(owner.isEmpty())
+            continue;
+
+        QString roomstatus;
+        if(room->game_finished)
+            roomstatus = "Finished";
+        else if(room->game_started)
+            roomstatus = "Playing";
+        else if(room->isFull())
+            roomstatus = "HALT!!!"; // is preparing
+        else
+            roomstatus = "Waiting";
+
+        lobby_room_count++;
+        lobby_rooms << QString("room %1:%2:%3:%4").arg(room->getTag("RoomID").toString())
+                       .arg(QString(owner.toUtf8().toBase64())).arg(playercount).arg(roomstatus);
+    }
+}
+
+void Server::touchNode(const QString &node){
+    if(nodeList.contains(node) && nodeList[node] == 0)
+        return;
+
+    nodeList.insert(node, clock());
+    if(!Config.HistoryNodeList.contains(node)){
+        Config.HistoryNodeList << node;
+        Config.HistoryNodeList.sort();
+        node_history_changed = true;
+    }
+}
+
+QStringList Server::liveNodes(){
+    QStringList nodes;
+    QMutableHashIterator<QString, long> itor(nodeList);
+    while(itor.hasNext()){
+        itor.next();
+        if(clock() - itor.value() > 30*1*1000*60 && itor.value() != 0)
+            itor.remove();
+        else
+            nodes << itor.key();
+    }
+
+    return nodes;
+}
+
+// node announcements only change the list in memory, timerTrigger writes it out
+void Server::saveNodeHistory(){
+    if(!node_history_changed)
+        return;
+
+    Config.setValue("HistoryNodeList", Config.HistoryNodeList);
+    node_history_changed = false;
+}
+
+void Server::handleSignup(ClientSocket *socket, const LobbyRequest &request){
+    QString command = request.args.at(1);
+    QString screen_name = request.args.at(2);
+    QString avatar = request.args.at(3);
+
+    if(Config.ContestMode){
+        QString password = request.args.value(4);
+        if(password.isEmpty()){
+            socket->send("warn REQUIRE_PASSWORD");
             socket->disconnectFromHost();
             return;
         }
-        else if(cmd.indexOf("Qnodeinfo")!=-1)
-        {
-            QStringList tmp=cmd.split(" ");
-            if(tmp.count()==2)
-            {
-                // 20111218 count toggle ready players
-                int robotcount=0;
-                int playercount=0;
-                int roomcount=0; // 20111220
-                foreach(Room *room, rooms){
-                    // playercount+=room->players.length();
-                    foreach(ServerPlayer *player, room->getPlayers()){
-                        if(player->getState() != "robot")
-                            playercount ++;
-                        else if(player->getState() == "robot")
-                            robotcount++;
-                    }
-                    // 20111220
-                    QString roomname=room->getTag("RoomOwnerScreenName").toString().trimmed();
-                    if(!roomname.isEmpty())
-                    {
-                        roomcount++;
-                    }
-                    //emit server_message("Qnodeinfo: "+reply);
-                }
-                //                QString reply=Config.Address.toLower()+":"+QString::number(Config.ServerPort)+":"+Config.GameMode+":"
-                //                              +QString::number(Config.Enable2ndGeneral?1:0)+":"+QString::number(this->rooms.count()-1)
-                //                              +":"+QString::number(playercount) +":"+tmp[1] ;
-                QString base64=Config.ServerName.toUtf8().toBase64();
-                QString version;
-//                if(Sanguosha->getVersion().contains(QChar(':')))
-//                    version = QString("%1%2").arg(Sanguosha->getVersion().split(QChar(':')).at(0)).arg(Sanguosha->getVersion().split(QChar(':')).at(1));
-//                else
-                version = Sanguosha->getVersion();
-                QString reply=Config.Address.toLower()+":"+QString::number(Config.ServerPort)+":"+base64+":"
-                              +version+":"+Config.GameMode+":"+QString::number(Config.Enable2ndGeneral?1:0)+":"
-                              +QString::number(roomcount)+":"+QString::number(playercount) +":"+tmp[1] ;
-                socket->send("nodeinfo "+reply);
-            }
+
+        password.remove(QChar(':'));
+        ContestDB *db = ContestDB::GetInstance();
+        if(!db->checkPassword(screen_name, password)){
+            socket->send("warn WRONG_PASSWORD");
             socket->disconnectFromHost();
             return;
         }
-        else if(cmd.indexOf("refreshRooms")!=-1) // 20111220 for reconnect
-        {
-            // emit server_message("refreshRooms");
-            if(rooms.count()<=1){socket->send("room 0"); socket->disconnectFromHost(); return;}
-            else if(cmd=="refreshRooms .")
-            {
-                foreach(Room *room, rooms)
-                {
-                    QString roomstatus="";
-
-                    if(room->game_finished){ roomstatus="Finished"; }
-                    else{
-                        if(room->game_started){ roomstatus="Playing"; }
-                        else{
-                            if(room->isFull()){roomstatus="HALT!!!";} // is prepareing
-                            else{roomstatus="Waiting";}
-                        }
-                    }
-
-                    int robotcount=0;
-                    int playercount=0;
-                    foreach(ServerPlayer *player, room->getPlayers()){
-                        if(player->getState() != "robot")
-                            playercount ++;
-                        else if(player->getState() == "robot")
-                            robotcount++;
-                    }
-                    QString base64=room->getTag("RoomOwnerScreenName").toString().trimmed();
-                    // 20111220
-                    if(!base64.isEmpty())
-                    {
-                        base64=base64.toUtf8().toBase64();
-                        // 20111222
-                        socket->send("room " + room->getTag("RoomID").toString() +":"+ base64 +":"+ QString::number(playercount) + ":" + roomstatus );
-                    }
-                }
-                socket->disconnectFromHost();
-                return;
-            }
-            else{
-                QRegExp rx("(refreshRooms?) (.+):(.+)?\n");
-                if(!rx.exactMatch(request)){
-                    emit server_message(tr("Invalid refreshRooms string: %1").arg(request));
-                    socket->send("warn INVALID_FORMAT");
-                    socket->disconnectFromHost();
-                    return;
-                }
-                QStringList texts = rx.capturedTexts();
-                QString command = texts.at(1);
-                QString screen_name = ConvertFromBase64(texts.at(2));
-                QString lastobjname = texts.at(3);
-                QString reply;
-
-                QHashIterator <QString, QString> i(name2objname);
-                while (i.hasNext()) {
-                    i.next();
-                    if(i.key()==screen_name && i.value()==lastobjname)
-                    {
-                        ServerPlayer *player = players.value(lastobjname);
-                        if(player && player->getState() == "offline" && player->isAlive()){
-                            reply=player->getRoom()->getTag("RoomID").toString();
-                            command ="foundRoomID "+reply;
-                            socket->send(command);
-                            socket->disconnectFromHost();
-                            return;
-                        }
-                    }
-                }
-                // 20111220 can't find room
-                command="refreshRooms .";
-                processRequest(command.toLatin1().data());
+    }
+
+    if(command == "signupr"){
+        foreach(QString objname, name2objname.values(screen_name)){
+            ServerPlayer *player = players.value(objname);
+            if(player && player->getState() == "offline"){
+                player->getRoom()->reconnect(player, socket);
                 return;
             }
-            socket->disconnectFromHost();
-            return;
         }
-        else if(cmd.indexOf("reJoinRoom")!=-1) // 20111220 rejoinroom
-        {
-            QRegExp rx("(reJoinRoom?) (.+):(.+):(.+):(.+):(.+)?\n");
-            if(!rx.exactMatch(request)){
-                emit server_message(tr("Invalid reJoinRoom string: %1").arg(request));
-                socket->send("warn INVALID_FORMAT");
-                socket->disconnectFromHost();
-                return;
-            }
+    }
 
-            QStringList texts = rx.capturedTexts();
-            //QString command = texts.at(1);
-            QString screen_name = ConvertFromBase64(texts.at(2));
-            //QString avatar = texts.at(3);
-            //QString roomid = texts.at(4);
-            QString version = texts.at(5);
-            QString sgsname = texts.at(6);
+    if(current == NULL || current->isFull()){
+        createNewRoom();
+        current->setTag("RoomOwnerScreenName",screen_name);
+    }
+    ServerPlayer *player = current->addSocket(socket);
+    current->signup(player, screen_name, avatar, false);
+}
 
-            if(version!=Sanguosha->getVersion()){
-                socket->send("warn INVALID_VERSION");
-                socket->disconnectFromHost();
-                return;
-            }
+void Server::handleNodeAnnouncement(ClientSocket *socket, const LobbyRequest &request){
+    if(request.args.length() >= 2)
+        touchNode(request.args.at(1));
 
-            // 20111222
-            ServerPlayer *player = players.value(sgsname);
-            if(player && player->getState() == "offline" && screen_name==player->screenName() && player->isAlive()){
-                Room *room=player->getRoom();
-                if(room->game_started && !room->game_finished){
-                    player->getRoom()->reconnect(player, socket);
-                }
-            }
-        }
-        else if(cmd.indexOf("joinRoom")!=-1)
-        {
-            QRegExp rx("(joinRoom?) (.+):(.+):(.+):(.+)?\n");
-            if(!rx.exactMatch(request)){
-                emit server_message(tr("Invalid joinRoom string: %1").arg(request));
-                socket->send("warn INVALID_FORMAT");
-                socket->disconnectFromHost();
-                return;
-            }
+    // a new node gets my node list in return
+    if(request.command == "iamnode"){
+        foreach(QString node, liveNodes())
+            socket->send("nodelist " + node);
+    }
 
-            QStringList texts = rx.capturedTexts();
-            QString command = texts.at(1);
-            QString screen_name = ConvertFromBase64(texts.at(2));
-            QString avatar = texts.at(3);
-            QString roomid = texts.at(4);
-            QString version = texts.at(5);
+    socket->disconnectFromHost();
+}
 
-            if(version!=Sanguosha->getVersion()){
-                socket->send("warn INVALID_VERSION");
-                socket->disconnectFromHost();
-                return;
-            }
+void Server::handleNodeListQuery(ClientSocket *socket, const LobbyRequest &){
+    foreach(QString node, liveNodes())
+        socket->send("nodelist " + node);
 
-            foreach(Room *room, rooms){
-                QString rid=room->getTag("RoomID").toString();
-                if(rid==roomid && !room->game_started && !room->game_finished && !(room->isFull()) )
-                {
-                    ServerPlayer *player = room->addSocket(socket);
-                    room->signup(player, screen_name, avatar, false);
-                    return;
-                }
-            }
+    socket->disconnectFromHost();
+}
 
-            socket->send("warn JOIN_ROOM_FAIL");
-            socket->disconnectFromHost();
-            return;
-        }
-        else if(cmd.indexOf("createRoom")!=-1)
-        {
-            QRegExp rx("(createRoom?) (.+):(.+):(.+)?\n");
-            if(!rx.exactMatch(request)){
-                emit server_message(tr("Invalid createRoom string: %1").arg(request));
-                socket->send("warn INVALID_FORMAT");
-                socket->disconnectFromHost();
-                return;
-            }
+void Server::handleNodeInfoQuery(ClientSocket *socket, const LobbyRequest &request){
+    if(request.args.length() == 2){
+        QString base64 = Config.ServerName.toUtf8().toBase64();
+        QString reply = Config.Address.toLower()+":"+QString::number(Config.ServerPort)+":"+base64+":"
+                        +version+":"+Config.GameMode+":"+QString::number(Config.Enable2ndGeneral?1:0)+":"
+                        +QString::number(lobby_room_count)+":"+QString::number(lobby_player_count)+":"+request.args.at(1);
+        socket->send("nodeinfo "+reply);
+    }
 
-            QStringList texts = rx.capturedTexts();
-            QString command = texts.at(1);
-            QString screen_name = ConvertFromBase64(texts.at(2));
-            QString avatar = texts.at(3);
-            QString version = texts.at(4);
+    socket->disconnectFromHost();
+}
 
-            if(version!=Sanguosha->getVersion()){
-                socket->send("warn INVALID_VERSION");
+void Server::handleRefreshRooms(ClientSocket *socket, const LobbyRequest &request){
+    if(rooms.count() <= 1){
+        socket->send("room 0");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    // "refreshRooms screen_name:objname" looks for a game to reconnect to first
+    if(request.args.length() == 4){
+        QString screen_name = request.args.at(2);
+        QString lastobjname = request.args.at(3);
+        if(name2objname.values(screen_name).contains(lastobjname)){
+            ServerPlayer *player = players.value(lastobjname);
+            if(player && player->getState() == "offline" && player->isAlive()){
+                socket->send("foundRoomID " + player->getRoom()->getTag("RoomID").toString());
                 socket->disconnectFromHost();
                 return;
             }
-
-            //Room* newRoom =  createNewRoom(); 20111222
-            createNewRoom();
-            ServerPlayer *player = current->addSocket(socket);
-            current->setTag("RoomOwnerScreenName",screen_name);
-            current->signup(player, screen_name, avatar, false);
-            // socket->send(".roomEntered " + newRoom->getTag("RoomID").toString()); // ֪ͻ˵ClientPlayerķ;
-            current->broadcastProperty(player, "owner");
-            return;
-        }
-        else
-        {
-            // unknow msg;
-            socket->send("warn UNKNOW_" + QString(request));
-            socket->disconnectFromHost();
-            return;
         }
     }
-    else // ԭsignupĹ
-    {
-        QRegExp rx("(signupr?) (.+):(.+)(:.+)?\n");
-        if(!rx.exactMatch(request)){
-            emit server_message(tr("Invalid signup string: %1").arg(request));
-            socket->send("warn INVALID_FORMAT");
-            socket->disconnectFromHost();
-            return;
-        }
 
-        QStringList texts = rx.capturedTexts();
-        QString command = texts.at(1);
-        QString screen_name = ConvertFromBase64(texts.at(2));
-        QString avatar = texts.at(3);
+    foreach(QString line, lobby_rooms)
+        socket->send(line);
 
-        if(Config.ContestMode){
-            QString password = texts.value(4);
-            if(password.isEmpty()){
-                socket->send("warn REQUIRE_PASSWORD");
-                socket->disconnectFromHost();
-                return;
-            }
+    socket->disconnectFromHost();
+}
 
-            password.remove(QChar(':'));
-            ContestDB *db = ContestDB::GetInstance();
-            if(!db->checkPassword(screen_name, password)){
-                socket->send("warn WRONG_PASSWORD");
-                socket->disconnectFromHost();
-                return;
-            }
-        }
+void Server::handleReJoinRoom(ClientSocket *socket, const LobbyRequest &request){
+    QString screen_name = request.args.at(2);
+    QString sgsname = request.args.at(6);
 
-        if(command == "signupr"){
-            foreach(QString objname, name2objname.values(screen_name)){
-                ServerPlayer *player = players.value(objname);
-                if(player && player->getState() == "offline"){
-                    player->getRoom()->reconnect(player, socket);
-                    return;
-                }
-            }
+    ServerPlayer *player = players.value(sgsname);
+    if(player && player->getState() == "offline" && screen_name==player->screenName() && player->isAlive()){
+        Room *room=player->getRoom();
+        if(room->game_started && !room->game_finished){
+            player->getRoom()->reconnect(player, socket);
         }
+    }
+}
 
-        //  if(current == NULL || current->isFull())
-        //       createNewRoom();
+void Server::handleJoinRoom(ClientSocket *socket, const LobbyRequest &request){
+    QString screen_name = request.args.at(2);
+    QString avatar = request.args.at(3);
+    QString roomid = request.args.at(4);
 
-        //  ServerPlayer *player = current->addSocket(socket);
-        //  current->signup(player, screen_name, avatar, false);
-        if(current == NULL || current->isFull()){
-            createNewRoom();
-            current->setTag("RoomOwnerScreenName",screen_name);
+    foreach(Room *room, rooms){
+        QString rid=room->getTag("RoomID").toString();
+        if(rid==roomid && !room->game_started && !room->game_finished && !(room->isFull()) )
+        {
+            ServerPlayer *player = room->addSocket(socket);
+            room->signup(player, screen_name, avatar, false);
+            return;
         }
-        ServerPlayer *player = current->addSocket(socket);
-        current->signup(player, screen_name, avatar, false);
     }
+
+    socket->send("warn JOIN_ROOM_FAIL");
+    socket->disconnectFromHost();
+}
+
+void Server::handleCreateRoom(ClientSocket *socket, const LobbyRequest &request){
+    QString screen_name = request.args.at(2);
+    QString avatar = request.args.at(3);
+
+    createNewRoom();
+    ServerPlayer *player = current->addSocket(socket);
+    current->setTag("RoomOwnerScreenName",screen_name);
+    current->signup(player, screen_name, avatar, false);
+    current->broadcastProperty(player, "owner");
+    refreshLobby();
 }
 
 void Server::cleanup(){
@@ -1520,6 +1456,31 @@ void Server::gameOver(){
         name2objname.remove(player->screenName(), player->objectName());
         players.remove(player->objectName());
     }
+
+    refreshLobby();
+}
+
+void Server::benchSnapshot(const GameState &state){
+    // fork the snapshot a room thread took and change one seat per fork
+    Room *room = qobject_cast<Room *>(sender());
+    if(room == NULL || state.playerCount() == 0)
+        return;
+
+    const int rounds = 100000;
+    QTime timer;
+    timer.start();
+    for(int i = 0; i < rounds; i++){
+        GameState branch = state.fork();
+        branch.player(i % branch.playerCount()).setHp(0);
+    }
+    int elapsed = qMax(timer.elapsed(), 1);
+    emit server_message(QString("cmd snapbench: RoomID:%1 -> %2 snapshots per second")
+                        .arg(room->getTag("RoomID").toString())
+                        .arg(rounds * 1000LL / elapsed));
+}
+
+QList<Room *> Server::getRooms() const{
+    return rooms.toList();
 }
 
 void Server::gamesOver(){
@@ -1574,8 +1535,10 @@ void Server::timerTrigger() // clear node list and announce
     }
 
 
-    if(!Config.AnnounceIP)
+    if(!Config.AnnounceIP){
+        saveNodeHistory();
         return;
+    }
 
     //emit server_message("timerTrigger");
     QHashIterator <QString, long> i(nodeList);
@@ -1587,9 +1550,7 @@ void Server::timerTrigger() // clear node list and announce
             {
                 nodeList.remove(i.key());
                 Config.HistoryNodeList.removeOne(i.key());
-                Config.HistoryNodeList.removeDuplicates();
-                Config.HistoryNodeList.sort();
-                Config.setValue("HistoryNodeList", Config.HistoryNodeList);
+                node_history_changed = true;
             }
             else
             {
@@ -1608,6 +1569,8 @@ void Server::timerTrigger() // clear node list and announce
             }
         }
     }
+
+    saveNodeHistory();
 }
 
 void Server::roomFinished(){
@@ -1620,6 +1583,49 @@ void Server::roomFinished(){
         players.remove(player->objectName());
     }
     room->releaseSource();
+    recycleLuaState(room);
+    refreshLobby();
+}
+
+void Server::recycleLuaState(Room *room){
+    // the room may still be running, it will recycle once it stops
+    connect(room, SIGNAL(finished()), room, SLOT(recycleLuaState()), Qt::UniqueConnection);
+    room->recycleLuaState();
+}
+
+// The card strings of the "log" lines in the records the server saved,
+// "<msecs> log #UseCard:from->to+to:<card string>:arg:arg2"; the targets and
+// the two arguments hold no ':', so the card string is whatever lies between
+static QStringList CollectRecordedCardStrings(const QString &dir_name, int limit){
+    QStringList card_strs;
+    QDir dir(dir_name);
+    foreach(QFileInfo entry, dir.entryInfoList(QStringList() << "*.txt", QDir::Files, QDir::Time)){
+        QFile file(entry.absoluteFilePath());
+        if(!file.open(QIODevice::ReadOnly))
+            continue;
+
+        while(!file.atEnd() && card_strs.length() < limit){
+            QByteArray line = file.readLine().trimmed();
+            int log_at = line.indexOf(" log ");
+            if(log_at == -1)
+                continue;
+
+            QString log = QString::fromUtf8(line.mid(log_at + 5));
+            int to_at = log.indexOf("->");
+            int card_from = to_at == -1 ? -1 : log.indexOf(':', to_at);
+            int arg2_at = log.lastIndexOf(':');
+            int arg_at = arg2_at <= 0 ? -1 : log.lastIndexOf(':', arg2_at - 1);
+            if(card_from == -1 || arg_at <= card_from + 1)
+                continue;
+
+            card_strs << log.mid(card_from + 1, arg_at - card_from - 1);
+        }
+
+        if(card_strs.length() >= limit)
+            break;
+    }
+
+    return card_strs;
 }
 
 void Server::processCmdLine()
@@ -1686,6 +1692,150 @@ void Server::processCmdLine()
         }
         return;
     }
+    else if(servercmd.indexOf("aistat")!=-1){
+        qint64 total_time = 0;
+        int total_count = 0;
+        foreach(Room *room, rooms)
+        {
+            RoomThread *thread = room->getThread();
+            if(thread == NULL)
+                continue;
+
+            total_time += thread->getAIWaitTime();
+            total_count += thread->getAIFilterCount();
+            emit server_message(QString("cmd aistat: RoomID:%1 -> %2 ms in %3 events")
+                                .arg(room->getTag("RoomID").toString())
+                                .arg(thread->getAIWaitTime()).arg(thread->getAIFilterCount()));
+        }
+        emit server_message(QString("cmd aistat: total %1 ms in %2 events").arg(total_time).arg(total_count));
+        return;
+    }
+    else if(servercmd.indexOf("netstat")!=-1){
+        qint64 total_bytes = 0;
+        qint64 total_count = 0;
+        foreach(Room *room, rooms)
+        {
+            total_bytes += room->getSerializedBytes();
+            total_count += room->getSerializedCount();
+            emit server_message(QString("cmd netstat: RoomID:%1 -> %2 bytes in %3 messages, %4 payloads for %5 card moves")
+                                .arg(room->getTag("RoomID").toString())
+                                .arg(room->getSerializedBytes()).arg(room->getSerializedCount())
+                                .arg(room->getMovePayloadCount()).arg(room->getMoveNotifyCount()));
+        }
+        emit server_message(QString("cmd netstat: total %1 bytes in %2 messages").arg(total_bytes).arg(total_count));
+        return;
+    }
+    else if(servercmd.indexOf("atombench")!=-1){
+        // the same mark lookups keyed by name, as before the atom table,
+        // by name through AtomTable::Find, and by a static atom; only atoms
+        // that already exist are used, the table is never grown from here
+        const int rounds = 1000000;
+        QStringList names;
+        QHash<QString, int> by_name;
+        QHash<int, int> by_atom;
+        QList<int> atoms;
+        for(int atom = 0; atoms.length() < 64; atom++){
+            QString name = AtomTable::Name(atom);
+            if(name.isEmpty())
+                break;
+
+            names << name;
+            by_name.insert(name, atom);
+            atoms << atom;
+            by_atom.insert(atom, atom);
+        }
+
+        const int count = atoms.length();
+        if(count == 0){
+            emit server_message("cmd atombench: the atom table is empty");
+            return;
+        }
+
+        qint64 checksum = 0;
+        QTime timer;
+        timer.start();
+        for(int i = 0; i < rounds; i++)
+            checksum += by_name.value(names.at(i % count));
+        int name_elapsed = qMax(timer.elapsed(), 1);
+
+        timer.restart();
+        for(int i = 0; i < rounds; i++)
+            checksum += by_atom.value(AtomTable::Find(names.at(i % count)));
+        int find_elapsed = qMax(timer.elapsed(), 1);
+
+        timer.restart();
+        for(int i = 0; i < rounds; i++)
+            checksum += by_atom.value(atoms.at(i % count));
+        int atom_elapsed = qMax(timer.elapsed(), 1);
+
+        emit server_message(QString("cmd atombench: by name %1, by name through the atom table %2, by atom %3 lookups per second (%4)")
+                            .arg(rounds * 1000LL / name_elapsed).arg(rounds * 1000LL / find_elapsed)
+                            .arg(rounds * 1000LL / atom_elapsed).arg(checksum));
+        return;
+    }
+    else if(servercmd.indexOf("parsebench")!=-1){
+        // the card strings of the saved records, newest first, parsed and
+        // freed again here, as no room adopts cards parsed in the main thread
+        const int parses = 100000;
+        QStringList corpus = CollectRecordedCardStrings("records", parses);
+        if(corpus.isEmpty()){
+            emit server_message("cmd parsebench: no card strings in records/*.txt");
+            return;
+        }
+
+        int rounds = qMax(parses / corpus.length(), 1);
+        int parsed = 0, virtual_cards = 0;
+        QTime timer;
+        timer.start();
+        for(int i = 0; i < rounds; i++){
+            foreach(QString str, corpus){
+                const Card *card = Card::Parse(str);
+                if(card == NULL)
+                    continue;
+
+                parsed++;
+                if(card->isVirtualCard()){
+                    virtual_cards++;
+                    delete card;
+                }
+            }
+        }
+        int elapsed = qMax(timer.elapsed(), 1);
+
+        emit server_message(QString("cmd parsebench: %1 parses per second over %2 recorded card strings, "
+                                    "%3 of %4 parsed, %5 virtual")
+                            .arg(rounds * corpus.length() * 1000LL / elapsed).arg(corpus.length())
+                            .arg(parsed).arg(rounds * corpus.length()).arg(virtual_cards));
+        return;
+    }
+    else if(servercmd.indexOf("snapbench")!=-1){
+        // the snapshots are taken by the room threads, see benchSnapshot
+        int requested = 0;
+        foreach(Room *room, rooms)
+        {
+            if(!room->game_started || room->game_finished)
+                continue;
+
+            connect(room, SIGNAL(snapshot_taken(GameState)), this, SLOT(benchSnapshot(GameState)), Qt::UniqueConnection);
+            room->requestSnapshot();
+            requested++;
+        }
+        emit server_message(QString("cmd snapbench: waiting for %1 rooms").arg(requested));
+        return;
+    }
+    else if(servercmd.indexOf("sched")!=-1){
+        RoomScheduler *scheduler = RoomScheduler::GetInstance();
+        emit server_message(QString("cmd sched: %1 running, %2 waiting for a slot, %3 parked of %4 slots, %5 parks")
+                            .arg(scheduler->getRunningCount()).arg(scheduler->getWaitingCount())
+                            .arg(scheduler->getParkedCount()).arg(scheduler->getCapacity())
+                            .arg(scheduler->getParkTimes()));
+        return;
+    }
+    else if(servercmd.indexOf("metrics")!=-1){
+        foreach(QString line, ServerMetrics::GetInstance()->toText().split("\n"))
+            emit server_message("cmd metrics: " + line);
+        return;
+    }
     else if(servercmd.indexOf("nodelist")!=-1)
     {
         QHashIterator <QString, long> i(nodeList);
@@ -1774,6 +1924,13 @@ void Server::processCmdLine()
         show.append("splayerlist\tserver side players with sgs name\n");
         show.append("playerlist\t\tcurrent players on server\n");
         show.append("ailist\t\tcurrent AIs on server\n");
+        show.append("aistat\t\ttime triggers spent waiting on AI\n");
+        show.append("netstat\t\tbytes serialized per room\n");
+        show.append("atombench\tmark lookups per second by name and by atom\n");
+        show.append("parsebench\tcard string parses per second over records/*.txt\n");
+        show.append("snapbench\tgame state snapshots per second\n");
+        show.append("sched\t\troom threads running and parked\n");
+        show.append("metrics\t\trequest latency, AI time and traffic\n");
         show.append("roomlist\t\tcurrent rooms on server\n");
         show.append("nodelist\t\tall nodes found on Inet\n");
         show.append("myconfig\t\tshow server settings\n");
@@ -1844,6 +2001,7 @@ bool Server::delRoom(int roomid){
             {
                 rooms.remove(room);
                 room->releaseSource();
+                recycleLuaState(room);
             }
             result=true;
         }
@@ -2,6 +2,7 @@
 #define SERVER_H
 
 class Room;
+class GameState;
 class QGroupBox;
 class QLabel;
 class QRadioButton;
@@ -141,6 +142,14 @@ private slots:
 class Scenario;
 class ServerPlayer;
 
+// a lobby line parsed by Server::processRequest
+struct LobbyRequest{
+    QString line;
+    QString command;
+    QStringList args; // the screen name in args[2] is already decoded
+    QString warning; // sent back instead of handling the request when set
+};
+
 class Server : public QObject{
     Q_OBJECT
 
@@ -153,6 +162,7 @@ public:
     Room *createNewRoom();
     void signupPlayer(ServerPlayer *player);
     void gamesOver();
+    QList<Room *> getRooms() const;
 
 private:
     QHash<QString, long> nodeList;
@@ -166,12 +176,39 @@ private:
     QMultiHash<QString, QString> name2objname;
     static int TimerCounts;
     bool delRoom(int roomid);
+    void recycleLuaState(Room *room);
+
+    // lobby commands by name, each handler runs on the main thread
+    typedef void (Server::*LobbyHandler)(ClientSocket *socket, const LobbyRequest &request);
+    QHash<QString, LobbyHandler> lobby_handlers;
+    QString version;
+
+    // what the lobby reports about the rooms, kept by refreshLobby()
+    QStringList lobby_rooms;
+    int lobby_room_count, lobby_player_count;
+    bool node_history_changed;
+
+    void initLobbyHandlers();
+    void touchNode(const QString &node);
+    QStringList liveNodes();
+
+    void handleSignup(ClientSocket *socket, const LobbyRequest &request);
+    void handleNodeAnnouncement(ClientSocket *socket, const LobbyRequest &request);
+    void handleNodeListQuery(ClientSocket *socket, const LobbyRequest &request);
+    void handleNodeInfoQuery(ClientSocket *socket, const LobbyRequest &request);
+    void handleRefreshRooms(ClientSocket *socket, const LobbyRequest &request);
+    void handleReJoinRoom(ClientSocket *socket, const LobbyRequest &request);
+    void handleJoinRoom(ClientSocket *socket, const LobbyRequest &request);
+    void handleCreateRoom(ClientSocket *socket, const LobbyRequest &request);
 
 private slots:
     void processNewConnection(ClientSocket *socket);
     void processRequest(char *request);
+    void refreshLobby();
+    void saveNodeHistory();
     void cleanup();
     void gameOver();
+    void benchSnapshot(const GameState &state);
 
     void process_SS_Reply(char *reply);
     void process_SS_error_message(QString);
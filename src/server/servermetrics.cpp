@@ -0,0 +1,278 @@
+#include "servermetrics.h"
+#include "server.h"
+#include "room.h"
+#include "roomthread.h"
+#include "roomscheduler.h"
+#include "serverplayer.h"
+#include "settings.h"
+#include <json/json.h>
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QFile>
+#include <QStringList>
+#include <QMutexLocker>
+#include <QMultiMap>
+
+ServerMetrics::Histogram::Histogram()
+    :count(0), total(0), max(0)
+{
+    for(int i = 0; i < BucketCount; i++)
+        buckets[i] = 0;
+}
+
+void ServerMetrics::Histogram::add(qint64 msecs){
+    int bucket = 0;
+    while(bucket < BucketCount - 1 && (1LL << bucket) <= msecs)
+        bucket++;
+
+    buckets[bucket]++;
+    count++;
+    total += msecs;
+    max = qMax(max, msecs);
+}
+
+// upper bound of the bucket holding the given percentile
+qint64 ServerMetrics::Histogram::percentile(int percent) const{
+    qint64 rank = (count * percent + 99) / 100, seen = 0;
+    for(int i = 0; i < BucketCount - 1; i++){
+        seen += buckets[i];
+        if(seen >= rank)
+            return qMin(1LL << i, max);
+    }
+
+    return max;
+}
+
+ServerMetrics::ServerMetrics()
+    :server(NULL), endpoint(NULL), dump_timer(NULL)
+{
+}
+
+ServerMetrics *ServerMetrics::GetInstance(){
+    static ServerMetrics *metrics;
+    if(metrics == NULL)
+        metrics = new ServerMetrics;
+
+    return metrics;
+}
+
+void ServerMetrics::recordRequest(QSanProtocol::CommandType command, qint64 msecs){
+    QMutexLocker locker(&mutex);
+    requests[command].add(msecs);
+}
+
+void ServerMetrics::recordAIDecision(const QString &callback, qint64 msecs){
+    QMutexLocker locker(&mutex);
+    decisions[callback].add(msecs);
+}
+
+void ServerMetrics::recordAIOverrun(const QString &callback){
+    QMutexLocker locker(&mutex);
+    overruns[callback]++;
+}
+
+void ServerMetrics::start(Server *server){
+    this->server = server;
+
+    if(Config.MetricsPort != 0 && endpoint == NULL){
+        endpoint = new QTcpServer(this);
+        connect(endpoint, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+        if(!endpoint->listen(QHostAddress::LocalHost, Config.MetricsPort))
+            qWarning("Metrics can not listen on port %d", Config.MetricsPort);
+    }
+
+    if(Config.MetricsInterval > 0 && dump_timer == NULL){
+        dump_timer = new QTimer(this);
+        connect(dump_timer, SIGNAL(timeout()), this, SLOT(dump()));
+        dump_timer->start(Config.MetricsInterval * 1000);
+    }
+}
+
+static QString HistogramLine(const QString &name, const ServerMetrics::Histogram &histogram){
+    return QString("%1: %2 times, avg %3 ms, p50 %4 ms, p90 %5 ms, p99 %6 ms, max %7 ms")
+            .arg(name).arg(histogram.count)
+            .arg(histogram.count > 0 ? histogram.total / histogram.count : 0)
+            .arg(histogram.percentile(50)).arg(histogram.percentile(90))
+            .arg(histogram.percentile(99)).arg(histogram.max);
+}
+
+QString ServerMetrics::toText() const{
+    QStringList lines;
+
+    if(server){
+        foreach(Room *room, server->getRooms()){
+            RoomThread *thread = room->getThread();
+            lines << QString("room %1 [%2]: %3 events, %4 ms waiting for AI, %5 ms parked, %6 bytes in %7 messages")
+                     .arg(room->getTag("RoomID").toString()).arg(room->getMode())
+                     .arg(thread ? thread->getTriggerCount() : 0)
+                     .arg(thread ? thread->getAIWaitTime() : 0)
+                     .arg(room->getWaitTime())
+                     .arg(room->getSerializedBytes()).arg(room->getSerializedCount());
+
+            foreach(ServerPlayer *player, room->getPlayers())
+                lines << QString("  %1 (%2): %3 bytes sent")
+                         .arg(player->objectName()).arg(player->getState()).arg(player->getSentBytes());
+        }
+    }
+
+    RoomScheduler *scheduler = RoomScheduler::GetInstance();
+    lines << QString("scheduler: %1 running, %2 waiting, %3 parked, %4 ms parked in total, %5 ms waiting for a slot")
+             .arg(scheduler->getRunningCount()).arg(scheduler->getWaitingCount())
+             .arg(scheduler->getParkedCount()).arg(scheduler->getParkedTime())
+             .arg(scheduler->getSlotWaitTime());
+
+    QMutexLocker locker(&mutex);
+
+    QList<int> commands = requests.keys();
+    qSort(commands);
+    foreach(int command, commands)
+        lines << HistogramLine(QString("request %1").arg(command), requests[command]);
+
+    QStringList callbacks = decisions.keys();
+    callbacks.sort();
+    foreach(QString callback, callbacks){
+        QString line = HistogramLine(QString("AI %1").arg(callback), decisions[callback]);
+        if(overruns.contains(callback))
+            line.append(QString(", %1 over budget").arg(overruns.value(callback)));
+        lines << line;
+    }
+
+    // slowest callbacks first, by their worst decision
+    QMultiMap<qint64, QString> slowest;
+    foreach(QString callback, callbacks)
+        slowest.insert(decisions[callback].max, callback);
+
+    QStringList names;
+    QMapIterator<qint64, QString> slowest_itor(slowest);
+    slowest_itor.toBack();
+    while(slowest_itor.hasPrevious() && names.length() < 5){
+        slowest_itor.previous();
+        names << QString("%1 (%2 ms)").arg(slowest_itor.value()).arg(slowest_itor.key());
+    }
+    if(!names.isEmpty())
+        lines << QString("slowest AI callbacks: %1").arg(names.join(", "));
+
+    return lines.join("\n");
+}
+
+static Json::Value HistogramValue(const ServerMetrics::Histogram &histogram){
+    Json::Value value(Json::objectValue);
+    value["count"] = (Json::Int64)histogram.count;
+    value["total_msecs"] = (Json::Int64)histogram.total;
+    value["max_msecs"] = (Json::Int64)histogram.max;
+    value["p50_msecs"] = (Json::Int64)histogram.percentile(50);
+    value["p90_msecs"] = (Json::Int64)histogram.percentile(90);
+    value["p99_msecs"] = (Json::Int64)histogram.percentile(99);
+
+    Json::Value buckets(Json::arrayValue);
+    for(int i = 0; i < ServerMetrics::Histogram::BucketCount; i++)
+        buckets.append((Json::Int64)histogram.buckets[i]);
+    value["buckets"] = buckets;
+
+    return value;
+}
+
+QByteArray ServerMetrics::toJSON() const{
+    Json::Value root(Json::objectValue);
+
+    Json::Value rooms(Json::arrayValue);
+    if(server){
+        foreach(Room *room, server->getRooms()){
+            RoomThread *thread = room->getThread();
+
+            Json::Value item(Json::objectValue);
+            item["id"] = room->getTag("RoomID").toInt();
+            item["mode"] = room->getMode().toStdString();
+            item["events"] = thread ? thread->getTriggerCount() : 0;
+            item["ai_wait_msecs"] = (Json::Int64)(thread ? thread->getAIWaitTime() : 0);
+            item["wait_msecs"] = room->getWaitTime();
+            item["serialized_bytes"] = room->getSerializedBytes();
+            item["serialized_messages"] = room->getSerializedCount();
+
+            Json::Value players(Json::arrayValue);
+            foreach(ServerPlayer *player, room->getPlayers()){
+                Json::Value player_item(Json::objectValue);
+                player_item["name"] = player->objectName().toStdString();
+                player_item["state"] = player->getState().toStdString();
+                player_item["sent_bytes"] = (Json::Int64)player->getSentBytes();
+                players.append(player_item);
+            }
+            item["players"] = players;
+
+            rooms.append(item);
+        }
+    }
+    root["rooms"] = rooms;
+
+    RoomScheduler *scheduler = RoomScheduler::GetInstance();
+    Json::Value scheduler_value(Json::objectValue);
+    scheduler_value["running"] = scheduler->getRunningCount();
+    scheduler_value["waiting"] = scheduler->getWaitingCount();
+    scheduler_value["parked"] = scheduler->getParkedCount();
+    scheduler_value["parked_msecs"] = (Json::Int64)scheduler->getParkedTime();
+    scheduler_value["slot_wait_msecs"] = (Json::Int64)scheduler->getSlotWaitTime();
+    root["scheduler"] = scheduler_value;
+
+    QMutexLocker locker(&mutex);
+
+    Json::Value request_values(Json::objectValue);
+    QHashIterator<int, Histogram> request_itor(requests);
+    while(request_itor.hasNext()){
+        request_itor.next();
+        request_values[QString::number(request_itor.key()).toStdString()] = HistogramValue(request_itor.value());
+    }
+    root["requests"] = request_values;
+
+    Json::Value decision_values(Json::objectValue);
+    QHashIterator<QString, Histogram> decision_itor(decisions);
+    while(decision_itor.hasNext()){
+        decision_itor.next();
+        Json::Value value = HistogramValue(decision_itor.value());
+        value["over_budget"] = overruns.value(decision_itor.key());
+        decision_values[decision_itor.key().toStdString()] = value;
+    }
+    root["ai_decisions"] = decision_values;
+
+    return QByteArray(Json::StyledWriter().write(root).c_str());
+}
+
+void ServerMetrics::acceptConnection(){
+    while(endpoint->hasPendingConnections()){
+        QTcpSocket *socket = endpoint->nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(serveRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+// "GET /json" answers with the JSON report, any other path with the text one
+void ServerMetrics::serveRequest(){
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if(socket == NULL || !socket->canReadLine())
+        return;
+
+    QList<QByteArray> words = socket->readLine().simplified().split(' ');
+    socket->disconnect(this);
+
+    QByteArray body, type;
+    if(words.length() >= 2 && words.at(1) == "/json"){
+        body = toJSON();
+        type = "application/json";
+    }else{
+        body = toText().toUtf8() + "\n";
+        type = "text/plain; charset=utf-8";
+    }
+
+    socket->write("HTTP/1.0 200 OK\r\nContent-Type: " + type
+                  + "\r\nContent-Length: " + QByteArray::number(body.size())
+                  + "\r\nConnection: close\r\n\r\n");
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+void ServerMetrics::dump(){
+    QFile file(Config.MetricsFile);
+    if(file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        file.write(toJSON());
+}
@@ -0,0 +1,67 @@
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+class Server;
+class QTcpServer;
+class QTimer;
+
+#include "protocol.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QString>
+
+// Collects request latencies and AI decision times from the room threads
+// and reports them together with the per room counters. The report is served
+// as text or JSON on a local port and dumped to a JSON file periodically.
+class ServerMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ServerMetrics *GetInstance();
+
+    // bucket 0 holds samples under 1 ms, bucket i those under 2^i ms
+    struct Histogram{
+        static const int BucketCount = 16;
+
+        Histogram();
+        void add(qint64 msecs);
+        qint64 percentile(int percent) const;
+
+        qint64 count, total, max;
+        qint64 buckets[BucketCount];
+    };
+
+    // called from room threads
+    void recordRequest(QSanProtocol::CommandType command, qint64 msecs);
+    void recordAIDecision(const QString &callback, qint64 msecs);
+    void recordAIOverrun(const QString &callback);
+
+    // binds the report to the server's rooms, listens on Config.MetricsPort
+    // and dumps to Config.MetricsFile every Config.MetricsInterval seconds
+    void start(Server *server);
+
+    QString toText() const;
+    QByteArray toJSON() const;
+
+private:
+    ServerMetrics();
+
+    Server *server;
+    QTcpServer *endpoint;
+    QTimer *dump_timer;
+
+    mutable QMutex mutex;
+    QHash<int, Histogram> requests;
+    QHash<QString, Histogram> decisions;
+    QHash<QString, int> overruns;
+
+private slots:
+    void acceptConnection();
+    void serveRequest();
+    void dump();
+};
+
+#endif // SERVERMETRICS_H
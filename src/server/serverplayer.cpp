@@ -7,16 +7,30 @@
 #include "recorder.h"
 #include "banpair.h"
 #include "lua-wrapper.h"
+#include "atom.h"
 
 using namespace QSanProtocol;
 
 const int ServerPlayer::S_NUM_SEMAPHORES = 2;
 
+// hasNullification is asked for every player on every trick
+static const int KanpoSkill = AtomTable::Intern("kanpo");
+static const int GuhuoSkill = AtomTable::Intern("guhuo");
+static const int LexueAtom = AtomTable::Intern("lexue");
+static const int YanzhengSkill = AtomTable::Intern("yanzheng");
+static const int LonghunSkill = AtomTable::Intern("longhun");
+static const int LonghunExSkill = AtomTable::Intern("longhunEx");
+static const int WushenSkill = AtomTable::Intern("wushen");
+
 ServerPlayer::ServerPlayer(Room *room)
-    : Player(room), m_isClientResponseReady(false), m_isWaitingReply(false),
+    : Player(room), m_isClientResponseReady(false), m_isWaitingReply(false), m_replyListener(NULL),
+    m_requestedCommand(S_COMMAND_UNKNOWN),
     socket(NULL), room(room),
-    ai(NULL), trust_ai(new TrustAI(this)), recorder(NULL), next(NULL), _m_clientResponse(Json::nullValue)
+    ai(NULL), trust_ai(new TrustAI(this)), recorder(NULL), next(NULL), _m_clientResponse(Json::nullValue),
+    binary_packet(false), sent_bytes(0)
 {
+    setDistanceMatrix(room->getDistanceMatrix());
+
      semas = new QSemaphore*[S_NUM_SEMAPHORES];
      for(int i=0; i< S_NUM_SEMAPHORES; i++){
          semas[i] = new QSemaphore(0);
@@ -25,6 +39,8 @@ ServerPlayer::ServerPlayer(Room *room)
 
 void ServerPlayer::drawCard(const Card *card){
     handcards << card;
+    if(handcards.length() == 1)
+        invalidateDistances();
 }
 
 Room *ServerPlayer::getRoom() const{
@@ -99,17 +115,19 @@ void ServerPlayer::throwAllHandCards(){
 
 void ServerPlayer::throwAllMarks(){
     // throw all marks
-    foreach(QString mark_name, marks.keys()){
+    foreach(int mark, marks.keys()){
+        QString mark_name = AtomTable::Name(mark);
         if(!mark_name.startsWith("@"))
             continue;
 
-        int n = marks.value(mark_name, 0);
+        int n = marks.value(mark, 0);
         if(n != 0){
             room->setPlayerMark(this, mark_name, 0);
         }
     }
 
     marks.clear();
+    invalidateDistances();
 }
 
 void ServerPlayer::clearPrivatePilesExcept(const QString &except){
@@ -126,6 +144,8 @@ void ServerPlayer::clearPrivatePilesExcept(const QString &except){
         }
         piles.remove(pile_name);
     }
+
+    invalidateDistances();
 }
 
 void ServerPlayer::clearPrivatePiles(){
@@ -141,6 +161,7 @@ void ServerPlayer::clearPrivatePiles(){
         }
     }
     piles.clear();
+    invalidateDistances();
 }
 
 void ServerPlayer::clearHistory(){
@@ -217,11 +238,15 @@ int ServerPlayer::getHandcardNum() const{
 }
 
 void ServerPlayer::setSocket(ClientSocket *socket){
+    // a new connection has to negotiate binary packets again
+    binary_packet = false;
+
     if(socket){
         connect(socket, SIGNAL(disconnected()), this, SIGNAL(disconnected()));
         connect(socket, SIGNAL(message_got(char*)), this, SLOT(getMessage(char*)));
 
-        connect(this, SIGNAL(message_cast(QString)), this, SLOT(castMessage(QString)));
+        connect(this, SIGNAL(message_cast(QByteArray)), this, SLOT(castMessage(QByteArray)));
+        connect(this, SIGNAL(packet_cast(QByteArray)), this, SLOT(castPacket(QByteArray)));
     }else{
         if(this->socket){
             this->disconnect(this->socket);
@@ -230,7 +255,8 @@ void ServerPlayer::setSocket(ClientSocket *socket){
             this->socket->deleteLater();
         }
 
-        disconnect(this, SLOT(castMessage(QString)));
+        disconnect(this, SLOT(castMessage(QByteArray)));
+        disconnect(this, SLOT(castPacket(QByteArray)));
     }
 
     this->socket = socket;
@@ -245,10 +271,22 @@ void ServerPlayer::getMessage(char *message){
 }
 
 void ServerPlayer::unicast(const QString &message) const{
-    emit message_cast(message);
+    unicastLine(room->serializeMessage(message));
+}
+
+void ServerPlayer::unicastLine(const QByteArray &line) const{
+    emit message_cast(line);
+
+    if(recorder)
+        recorder->recordLine(line);
+}
+
+void ServerPlayer::unicastFrame(const QByteArray &frame, const QByteArray &line) const{
+    emit packet_cast(frame);
 
+    // records are always kept in the text form so that replays stay readable
     if(recorder)
-        recorder->recordLine(message);
+        recorder->recordLine(line);
 }
 
 void ServerPlayer::startNetworkDelayTest(){
@@ -332,19 +370,37 @@ void ServerPlayer::clearSelected(){
     selected.clear();
 }
 
-void ServerPlayer::castMessage(const QString &message){
+void ServerPlayer::castMessage(const QByteArray &message){
     if(socket){
-        socket->send(message);
+        socket->sendLine(message);
+        sent_bytes.fetchAndAddRelaxed(message.size() + 1);
 
 #ifndef QT_NO_DEBUG
-        qDebug("%s: %s", qPrintable(objectName()), qPrintable(message));
+        qDebug("%s: %s", qPrintable(objectName()), message.constData());
 #endif
     }
 }
 
+void ServerPlayer::setBinaryPacket(bool enabled){
+    binary_packet = enabled && socket != NULL;
+}
+
+void ServerPlayer::castPacket(const QByteArray &payload){
+    if(socket){
+        socket->sendFrame(payload);
+        sent_bytes.fetchAndAddRelaxed(payload.size() + 5); // marker and length header
+    }
+}
+
 void ServerPlayer::invoke(const QSanPacket* packet)
 {
-    unicast(QString(packet->toString().c_str()));
+    if(binary_packet){
+        QByteArray line;
+        if(recorder)
+            line = room->serializePacket(packet, false);
+        unicastFrame(room->serializePacket(packet, true), line);
+    }else
+        unicastLine(room->serializePacket(packet, false));
 }
 
 void ServerPlayer::invoke(const char *method, const QString &arg){
@@ -370,7 +426,9 @@ void ServerPlayer::sendProperty(const char *property_name, const Player *player)
 void ServerPlayer::removeCard(const Card *card, Place place){
     switch(place){
     case PlaceHand: {
-            handcards.removeOne(card);
+            // distance skills may look at whether the hand is empty (scene 13)
+            if(handcards.removeOne(card) && handcards.isEmpty())
+                invalidateDistances();
             break;
         }
     case PlaceTakeoff: {
@@ -404,6 +462,7 @@ void ServerPlayer::removeCard(const Card *card, Place place){
             //@todo: sanity check required
             if (!pile_name.isEmpty())
                 piles[pile_name].removeOne(card_id);
+            invalidateDistances();
 
             break;
         }
@@ -418,6 +477,8 @@ void ServerPlayer::addCard(const Card *card, Place place){
     switch(place){
     case PlaceHand: {
             handcards << card;
+            if(handcards.length() == 1)
+                invalidateDistances();
             break;
         }
     case PlaceTakeoff: {
@@ -498,17 +559,17 @@ DummyCard *ServerPlayer::wholeHandCards() const{
 }
 
 bool ServerPlayer::hasNullification() const{
-    if(hasSkill("kanpo")){
+    if(hasSkill(KanpoSkill)){
         foreach(const Card *card, handcards){
             if(card->isBlack() || card->objectName() == "nullification")
                 return true;
         }
     }
-    if(hasSkill("guhuo")){
+    if(hasSkill(GuhuoSkill)){
         return !isKongcheng();
     }
-    if(hasFlag("lexue")){
-        int card_id = getMark("lexue");
+    if(hasFlag(LexueAtom)){
+        int card_id = getMark(LexueAtom);
         const Card *card = Sanguosha->getCard(card_id);
         if(card->objectName() == "nullification"){
             foreach(const Card *c, handcards + getEquips()){
@@ -517,12 +578,12 @@ bool ServerPlayer::hasNullification() const{
             }
         }
     }
-    if(hasSkill("yanzheng")){
+    if(hasSkill(YanzhengSkill)){
         if(getHandcardNum() > getHp() && !getEquips().isEmpty())
             return true;
     }
 
-    if(hasSkill("longhun")){
+    if(hasSkill(LonghunSkill)){
         int n = qMax(1, getHp());
         int count = 0;
         foreach(const Card *card, handcards + getEquips()){
@@ -533,7 +594,7 @@ bool ServerPlayer::hasNullification() const{
             return true;
     }
 
-    if(hasSkill("longhunEx")){
+    if(hasSkill(LonghunExSkill)){
         foreach(const Card *card, handcards + getEquips()){
             if(card->getSuit() == Card::Spade)
                 return true;
@@ -554,7 +615,7 @@ bool ServerPlayer::hasNullification() const{
         }
     }
 
-    if(hasSkill("wushen")){
+    if(hasSkill(WushenSkill)){
         foreach(const Card *card, handcards){
             if(card->objectName() == "nullification" && card->getSuit() != Card::Heart)
                 return true;
@@ -808,6 +869,10 @@ QString ServerPlayer::getGameMode() const{
     return room->getMode();
 }
 
+qint64 ServerPlayer::getSentBytes() const{
+    return (int)sent_bytes;
+}
+
 QString ServerPlayer::getIp() const{
     if(socket)
         return socket->peerAddress();
@@ -887,9 +952,10 @@ void ServerPlayer::marshal(ServerPlayer *player) const{
                        .arg(objectName()));
     }
 
-    foreach(QString mark_name, marks.keys()){
+    foreach(int mark, marks.keys()){
+        QString mark_name = AtomTable::Name(mark);
         if(mark_name.startsWith("@")){
-            int value = getMark(mark_name);
+            int value = getMark(mark);
             if(value != 0){
                 QString mark_str = QString("%1.%2=%3")
                                    .arg(objectName())
@@ -905,8 +971,8 @@ void ServerPlayer::marshal(ServerPlayer *player) const{
         player->invoke("acquireSkill", QString("%1:%2").arg(objectName()).arg(skill_name));
     }
 
-    foreach(QString flag, flags){
-        player->unicast(QString("#%1 flags %2").arg(objectName()).arg(flag));
+    foreach(int flag, flags){
+        player->unicast(QString("#%1 flags %2").arg(objectName()).arg(AtomTable::Name(flag)));
     }
 
     foreach(QString item, history.keys()){
@@ -925,17 +991,21 @@ void ServerPlayer::addToPile(const QString &pile_name, const Card *card, bool op
     else
         piles[pile_name] << card->getEffectiveId();
 
+    invalidateDistances();
     room->moveCardTo(card, this, Player::PlaceSpecial, open);
 }
 
 void ServerPlayer::addToPile(const QString &pile_name, int card_id, bool open){
     piles[pile_name] << card_id;
 
+    invalidateDistances();
     room->moveCardTo(Sanguosha->getCard(card_id), this, Player::PlaceSpecial, open);
 }
 
 void ServerPlayer::addToPile(const QString &pile_name, QList<int> card_ids, bool open){
     piles[pile_name].append(card_ids);
+    invalidateDistances();
+
     CardsMoveStruct move;
     move.card_ids = card_ids;
     move.to = this;
@@ -12,6 +12,7 @@ class Recorder;
 
 #include <QSemaphore>
 #include <QDateTime>
+#include <QAtomicInt>
 
 class ServerPlayer : public Player
 {
@@ -23,11 +24,16 @@ public:
     explicit ServerPlayer(Room *room);
 
     void setSocket(ClientSocket *socket);
+    void setBinaryPacket(bool enabled);
     void invoke(const QSanProtocol::QSanPacket* packet);
     void invoke(const char *method, const QString &arg = ".");
     QString reportHeader() const;
     void sendProperty(const char *property_name, const Player *player = NULL) const;
     void unicast(const QString &message) const;
+    void unicastLine(const QByteArray &line) const;
+    void unicastFrame(const QByteArray &frame, const QByteArray &line) const;
+    inline bool isBinaryPacket() const{ return binary_packet; }
+    inline bool isRecording() const{ return recorder != NULL; }
     void drawCard(const Card *card);
     Room *getRoom() const;
     void playCardEffect(const Card *card) const;
@@ -97,6 +103,7 @@ public:
     virtual QString getGameMode() const;
 
     QString getIp() const;
+    qint64 getSentBytes() const;
     void introduceTo(ServerPlayer *player);
     void marshal(ServerPlayer *player) const;
 
@@ -125,7 +132,11 @@ public:
     inline bool tryAcquireLock(SemaphoreType type, int timeout = 0){
         return semas[type]->tryAcquire(1, timeout);
     }
-    inline void releaseLock(SemaphoreType type){ semas[type]->release(); }
+    inline void releaseLock(SemaphoreType type){
+        semas[type]->release();
+        if (type == SEMA_COMMAND_INTERACTIVE && m_replyListener != NULL)
+            m_replyListener->release();
+    }
     inline void drainLock(SemaphoreType type){ while ((semas[type]->tryAcquire())) ; }
     inline void drainAllLocks(){
         for(int i=0; i< S_NUM_SEMAPHORES; i++){
@@ -139,8 +150,11 @@ public:
     unsigned int m_expectedReplySerial; // Suggest the acceptable serial number of an expected response.
     bool m_isClientResponseReady; //Suggest whether a valid player's reponse has been received.
     bool m_isWaitingReply; // Suggest if the server player is waiting for client's response.
+    QSemaphore *m_replyListener; // Also released with SEMA_COMMAND_INTERACTIVE while a broadcast request waits on us.
     Json::Value m_cheatArgs; // Store the cheat code received from client.
     QSanProtocol::CommandType m_expectedReplyCommand; // Store the command to be sent to the client.
+    QSanProtocol::CommandType m_requestedCommand; // The command sent to the client, the metrics file its latency under it.
+    QTime m_requestTime; // Started when the request is sent, read by the metrics once it is answered.
     Json::Value m_commandArgs; // Store the command args to be sent to the client.
 
 protected:
@@ -163,15 +177,19 @@ private:
     QDateTime test_time;
     QString m_clientResponseString;
     Json::Value _m_clientResponse;
+    bool binary_packet;
+    QAtomicInt sent_bytes; // also read by the metrics from the main thread
 
 private slots:
     void getMessage(char *message);
-    void castMessage(const QString &message);
+    void castMessage(const QByteArray &message);
+    void castPacket(const QByteArray &payload);
 
 signals:
     void disconnected();
     void request_got(const QString &request);
-    void message_cast(const QString &message) const;
+    void message_cast(const QByteArray &message) const;
+    void packet_cast(const QByteArray &payload) const;
 };
 
 #endif // SERVERPLAYER_H
@@ -475,12 +475,27 @@ ReplayerControlBar::ReplayerControlBar(Dashboard *dashboard){
     QWidgetList widgets;
     widgets << uniform << slow_down << play << speed_up << time_label;
 
+    Replayer *replayer = ClientInstance->getReplayer();
+
+    // records with keyframes can jump between turns
+    if(replayer->getTurnCount() > 0){
+        QPushButton *previous_turn = new QPushButton("<<");
+        previous_turn->setToolTip(tr("Previous turn"));
+        QPushButton *next_turn = new QPushButton(">>");
+        next_turn->setToolTip(tr("Next turn"));
+
+        widgets.insert(widgets.indexOf(time_label), previous_turn);
+        widgets.insert(widgets.indexOf(time_label), next_turn);
+
+        connect(previous_turn, SIGNAL(clicked()), replayer, SLOT(previousTurn()));
+        connect(next_turn, SIGNAL(clicked()), replayer, SLOT(nextTurn()));
+    }
+
     foreach(QWidget *widget, widgets){
         widget->setEnabled(true);
         layout->addWidget(widget);
     }
 
-    Replayer *replayer = ClientInstance->getReplayer();
     connect(play, SIGNAL(clicked()), replayer, SLOT(toggle()));
     connect(play, SIGNAL(clicked()), this, SLOT(toggle()));
     connect(uniform, SIGNAL(clicked()), replayer, SLOT(uniform()));
@@ -5,6 +5,14 @@
 #include <QRegExp>
 #include <QStringList>
 #include <QUdpSocket>
+#include <QtEndian>
+
+// A binary frame is a marker byte, a big-endian payload length and the payload.
+// Text lines are ASCII, so the marker can never start one and both kinds may
+// share a connection.
+static const uchar FrameMarker = 0xFF;
+static const int FrameHeaderSize = 1 + sizeof(quint32);
+static const quint32 MaxFrameSize = 1 << 20;
 
 NativeServerSocket::NativeServerSocket()
 {
@@ -88,11 +96,35 @@ void NativeClientSocket::connectToNode(QString addr, int port){
 }
 
 void NativeClientSocket::getMessage(){
-    while(socket->canReadLine()){
-        buffer_t msg;
-        socket->readLine(msg, sizeof(msg));        
-
-        emit message_got(msg);
+    forever{
+        char head;
+        if(socket->peek(&head, 1) != 1)
+            break;
+
+        if((uchar)head == FrameMarker){
+            if(socket->bytesAvailable() < FrameHeaderSize)
+                break;
+
+            QByteArray header = socket->peek(FrameHeaderSize);
+            quint32 length = qFromBigEndian<quint32>((const uchar *)header.constData() + 1);
+            if(length > MaxFrameSize){
+                emit error_message(tr("Oversized packet (%1 bytes) received").arg(length));
+                socket->abort();
+                break;
+            }
+
+            if(socket->bytesAvailable() < FrameHeaderSize + length)
+                break;
+
+            socket->read(FrameHeaderSize);
+            emit frame_got(socket->read(length));
+        }else{
+            if(!socket->canReadLine())
+                break;
+
+            QByteArray msg = socket->readLine();
+            emit message_got(msg.data());
+        }
     }
 }
 
@@ -101,10 +133,22 @@ void NativeClientSocket::disconnectFromHost(){
 }
 
 void NativeClientSocket::send(const QString &message){
-    socket->write(message.toAscii());
+    sendLine(message.toAscii());
+}
+
+void NativeClientSocket::sendLine(const QByteArray &line){
+    socket->write(line);
     socket->write("\n");
 }
 
+void NativeClientSocket::sendFrame(const QByteArray &payload){
+    uchar header[FrameHeaderSize];
+    header[0] = FrameMarker;
+    qToBigEndian<quint32>(payload.size(), header + 1);
+    socket->write((const char *)header, FrameHeaderSize);
+    socket->write(payload);
+}
+
 bool NativeClientSocket::isConnected() const{
     return socket->state() == QTcpSocket::ConnectedState;
 }
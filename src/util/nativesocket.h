@@ -35,6 +35,8 @@ public:
     void connectToNode(QString addr, int port);
     virtual void disconnectFromHost();
     virtual void send(const QString &message);
+    virtual void sendLine(const QByteArray &line);
+    virtual void sendFrame(const QByteArray &payload);
     virtual bool isConnected() const;
     virtual QString peerName() const;
     virtual QString peerAddress() const;
@@ -7,36 +7,97 @@
 #include <QFile>
 #include <QBuffer>
 #include <QMessageBox>
+#include <QTemporaryFile>
+#include <QDataStream>
 using namespace QSanProtocol;
 
+const int Recorder::ChunkSize = 64 * 1024;
+
 Recorder::Recorder(QObject *parent)
-    :QObject(parent)
+    :QObject(parent), spool(NULL)
 {
     watch.start();
 }
 
 void Recorder::record(char *line)
 {
-    recordLine(line);
+    recordLine(QByteArray(line));
 }
 
 void Recorder::recordLine(const QString &line){
-    int elapsed = watch.elapsed();
-    if(line.endsWith("\n"))
-        data.append(QString("%1 %2").arg(elapsed).arg(line));
-    else
-        data.append(QString("%1 %2\n").arg(elapsed).arg(line));
+    recordLine(line.toAscii());
+}
+
+void Recorder::recordLine(const QByteArray &line){
+    data.append(QByteArray::number(watch.elapsed()));
+    data.append(' ');
+    data.append(line);
+    if(!line.endsWith('\n'))
+        data.append('\n');
+
+    if(data.size() >= ChunkSize)
+        flush();
+}
+
+void Recorder::recordKeyframe(int turn, const QStringList &lines){
+    recordLine(QByteArray("keyframe ") + QByteArray::number(turn));
+    foreach(QString line, lines)
+        recordLine(line);
+    recordLine(QByteArray("keyframe-end"));
+}
+
+void Recorder::flush(){
+    if(spool == NULL){
+        spool = new QTemporaryFile(this);
+        if(!spool->open()){
+            // no spool, keep everything in memory as before
+            delete spool;
+            spool = NULL;
+            return;
+        }
+    }
+
+    QDataStream stream(spool);
+    stream << qCompress(data);
+    data.clear();
+}
+
+bool Recorder::writeTo(QIODevice *device) const{
+    if(spool){
+        spool->flush();
+        spool->seek(0);
+        QDataStream stream(spool);
+        while(!stream.atEnd()){
+            QByteArray chunk;
+            stream >> chunk;
+            if(device->write(qUncompress(chunk)) == -1){
+                spool->seek(spool->size());
+                return false;
+            }
+        }
+        spool->seek(spool->size());
+    }
+
+    return device->write(data) != -1;
+}
+
+QByteArray Recorder::getData() const{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    writeTo(&buffer);
+    return buffer.data();
 }
 
 bool Recorder::save(const QString &filename) const{
     if(filename.endsWith(".txt")){
+        // chunks are written one at a time, never the whole record at once
         QFile file(filename);
         if(file.open(QIODevice::WriteOnly | QIODevice::Text))
-            return file.write(data) != -1;
+            return writeTo(&file);
         else
             return false;
     }else if(filename.endsWith(".png")){
-        return TXT2PNG(data).save(filename);
+        return TXT2PNG(getData()).save(filename);
     }else
         return false;
 }
@@ -60,7 +121,8 @@ QImage Recorder::TXT2PNG(QByteArray txtData){
 
 Replayer::Replayer(QObject *parent, const QString &filename)
     :QThread(parent), m_isOldVersion(false), m_commandSeriesCounter(1),
-      filename(filename), speed(1.0), playing(true)
+      filename(filename), speed(1.0), playing(true),
+      prologue(-1), start_turn(-1), position(0), target(0), stopped(false)
 {
     QIODevice *device = NULL;
     if(filename.endsWith(".png")){
@@ -78,35 +140,45 @@ Replayer::Replayer(QObject *parent, const QString &filename)
     if(!device->open(QIODevice::ReadOnly | QIODevice::Text))
         return;
 
-    typedef char buffer_t[1024];
-
+    // only split the lines and index the keyframes here,
+    // old protocol commands are translated as they are played
     initCommandPair();
     while(!device->atEnd()){
-        buffer_t line;
-        memset(line, 0, sizeof(buffer_t));
-        device->readLine(line, sizeof(buffer_t));
+        QByteArray line = device->readLine();
 
-        char *space = strchr(line, ' ');
-        if(space == NULL)
+        int space = line.indexOf(' ');
+        if(space == -1)
             continue;
 
-        *space = '\0';
-        QString cmd = space + 1;
-        int elapsed = atoi(line);
-
-        //@todo: There is a serious problem that the old protocol didn't has
-        //any tag or type definition for the sent messages, and if the old protocol
-        // wants to be translated to the new protocol, there is no information for the package type
-        //and client will be confused of showing dialog or not.
-        commandTranslation(cmd);
-
         Pair pair;
-        pair.elapsed = elapsed;
-        pair.cmd = cmd;
+        pair.elapsed = line.left(space).toInt();
+        pair.cmd = line.mid(space + 1);
+
+        if(pair.cmd.startsWith("keyframe ")){
+            Keyframe keyframe;
+            keyframe.turn = pair.cmd.mid(9).trimmed().toInt();
+            keyframe.elapsed = pair.elapsed;
+            keyframe.begin = pairs.length();
+            keyframe.end = -1;
+            keyframes << keyframe;
+        }else if(pair.cmd.startsWith("keyframe-end")){
+            if(!keyframes.isEmpty())
+                keyframes.last().end = pairs.length();
+        }else if(prologue == -1 && pair.cmd.startsWith("arrangeSeats"))
+            prologue = pairs.length();
+        else if(!m_isOldVersion && isObsolete(pair.cmd))
+            m_isOldVersion = true;
 
         pairs << pair;
     }
 
+    // a keyframe cut off by the end of the record is of no use
+    if(!keyframes.isEmpty() && keyframes.last().end == -1)
+        keyframes.removeLast();
+
+    if(prologue == -1 || m_isOldVersion)
+        keyframes.clear();
+
     if(m_isOldVersion){
         QMessageBox::warning(NULL, tr("Warning"), tr("The replay use old protocol"));
     }
@@ -114,6 +186,15 @@ Replayer::Replayer(QObject *parent, const QString &filename)
     delete device;
 }
 
+Replayer::~Replayer(){
+    mutex.lock();
+    stopped = true;
+    mutex.unlock();
+
+    play_sem.release();
+    wait();
+}
+
 QByteArray Replayer::PNG2TXT(const QString filename){
     QImage image(filename);
     image = image.convertToFormat(QImage::Format_ARGB32);
@@ -268,10 +349,78 @@ void Replayer::initCommandPair(){
     }
 }
 
+bool Replayer::isObsolete(const QByteArray &cmd) const{
+    // new protocol packets are JSON arrays
+    if(cmd.startsWith('['))
+        return false;
+
+    if((cmd.startsWith("setStatistics") && !cmd.contains('.')) || cmd.startsWith("disableAG"))
+        return true;
+
+    int space = cmd.indexOf(' ');
+    QString method = QString::fromAscii(space == -1 ? cmd.trimmed() : cmd.left(space));
+    return m_commandMapping.contains(method);
+}
+
+QString Replayer::getFilename() const{
+    return filename;
+}
+
 int Replayer::getDuration() const{
+    if(pairs.isEmpty())
+        return 0;
+
     return pairs.last().elapsed / 1000.0;
 }
 
+int Replayer::getTurnCount() const{
+    return keyframes.length();
+}
+
+void Replayer::setStartTurn(int turn){
+    start_turn = turn;
+}
+
+int Replayer::currentTurn(){
+    QMutexLocker locker(&mutex);
+
+    int turn = -1;
+    for(int i = 0; i < keyframes.length() && keyframes.at(i).begin <= position; i++)
+        turn = i;
+
+    return turn;
+}
+
+void Replayer::nextTurn(){
+    int turn = currentTurn() + 1;
+    if(turn >= keyframes.length())
+        return;
+
+    mutex.lock();
+    target = keyframes.at(turn).begin;
+    mutex.unlock();
+
+    // fast-forward even when paused, it pauses again on arrival
+    if(!playing)
+        play_sem.release();
+}
+
+void Replayer::previousTurn(){
+    int turn = currentTurn();
+    if(turn == -1)
+        return;
+    else if(turn > 0)
+        turn--;
+
+    // the client can not undo what it has shown, so we start over from the keyframe
+    mutex.lock();
+    stopped = true;
+    mutex.unlock();
+
+    play_sem.release();
+    emit rewind_requested(turn);
+}
+
 qreal Replayer::getSpeed() {
     qreal speed;
     mutex.lock();
@@ -323,20 +472,62 @@ void Replayer::toggle(){
 
 void Replayer::run(){
     int last = 0;
+    int i = 0, next_keyframe = 0;
+
+    if(start_turn >= 0 && start_turn < keyframes.length()){
+        // rebuild the table like a reconnecting client: the lobby part of
+        // the record, then the keyframe, then play on from there
+        const Keyframe &keyframe = keyframes.at(start_turn);
+        for(int j = 0; j < prologue; j++)
+            emit command_parsed(QString::fromAscii(pairs.at(j).cmd));
+        for(int j = keyframe.begin + 1; j < keyframe.end; j++)
+            emit command_parsed(QString::fromAscii(pairs.at(j).cmd));
+
+        i = keyframe.end + 1;
+        next_keyframe = start_turn + 1;
+        last = keyframe.elapsed;
+        emit elasped(last / 1000.0);
+    }
 
     QStringList nondelays;
     nondelays << "addPlayer" << "removePlayer" << "speak";
 
-    foreach(Pair pair, pairs){
-        if(pair.cmd.startsWith("[") && m_isOldVersion && !pair.cmd.contains("3,35")
-                && !pair.cmd.contains("3,5") )
+    for(; i < pairs.length(); i++){
+        if(next_keyframe < keyframes.length() && keyframes.at(next_keyframe).begin == i){
+            i = keyframes.at(next_keyframe).end;
+            next_keyframe++;
             continue;
+        }
+
+        mutex.lock();
+        if(stopped){
+            mutex.unlock();
+            return;
+        }
+        position = i;
+        bool seeking = i < target;
+        mutex.unlock();
+
+        const Pair &pair = pairs.at(i);
+        QString cmd = QString::fromAscii(pair.cmd);
+
+        if(m_isOldVersion){
+            //@todo: There is a serious problem that the old protocol didn't has
+            //any tag or type definition for the sent messages, and if the old protocol
+            // wants to be translated to the new protocol, there is no information for the package type
+            //and client will be confused of showing dialog or not.
+            commandTranslation(cmd);
+
+            if(cmd.startsWith("[") && !cmd.contains("3,35") && !cmd.contains("3,5"))
+                continue;
+        }
+
         int delay = qMin(pair.elapsed - last, 1500);
         last = pair.elapsed;
 
-        bool delayed = true;
+        bool delayed = !seeking;
         foreach(QString nondelay, nondelays){
-            if(pair.cmd.startsWith(nondelay)){
+            if(cmd.startsWith(nondelay)){
                 delayed = false;
                 break;
             }
@@ -350,8 +541,9 @@ void Replayer::run(){
 
             if(!playing)
                 play_sem.acquire();
-        }
+        }else if(seeking && i + 1 == target)
+            emit elasped(pair.elapsed / 1000.0);
 
-        emit command_parsed(pair.cmd);
+        emit command_parsed(cmd);
     }
 }
@@ -11,6 +11,11 @@
 #include <QImage>
 #include <QMap>
 
+class QTemporaryFile;
+
+// Lines are buffered in memory up to ChunkSize, then compressed and appended
+// to a temporary spool file, so a long game costs disk rather than memory.
+// save() exports the whole record as .txt or .png.
 class Recorder : public QObject
 {
     Q_OBJECT
@@ -19,13 +24,27 @@ public:
     static QImage TXT2PNG(QByteArray data);
     bool save(const QString &filename) const;
     void recordLine(const QString &line);
+    void recordLine(const QByteArray &line);
+
+    // a block of lines that rebuilds the game state at the start of a turn,
+    // the replayer skips it while playing and starts from it when seeking
+    void recordKeyframe(int turn, const QStringList &lines);
+
+    // the whole record as text, read back from the spool
+    QByteArray getData() const;
+
+    static const int ChunkSize;
 
 public slots:
     void record(char *line);
 
 private:
     QTime watch;
-    QByteArray data;
+    QByteArray data; // lines not yet flushed
+    QTemporaryFile *spool;
+
+    void flush();
+    bool writeTo(QIODevice *device) const;
 };
 
 class Replayer: public QThread
@@ -34,14 +53,20 @@ class Replayer: public QThread
 
 public:
     explicit Replayer(QObject *parent, const QString &filename);
+    ~Replayer();
     static QByteArray PNG2TXT(const QString filename);
 
     void initCommandPair();
     QString &commandTranslation(QString &cmd);
     QString &commandProceed(QString &cmd);
+    QString getFilename() const;
     int getDuration() const;
     qreal getSpeed();
 
+    // turns are counted by keyframes, call setStartTurn before start()
+    int getTurnCount() const;
+    void setStartTurn(int turn);
+
     bool m_isOldVersion;
     int m_commandSeriesCounter;
 
@@ -50,6 +75,8 @@ public slots:
     void toggle();
     void speedUp();
     void slowDown();
+    void nextTurn();
+    void previousTurn();
 
 protected:
     virtual void run();
@@ -63,10 +90,25 @@ private:
 
     struct Pair{
         int elapsed;
-        QString cmd;
+        QByteArray cmd;
     };
     QList<Pair> pairs;
 
+    struct Keyframe{
+        int turn;
+        int elapsed;
+        int begin, end; // indices of the "keyframe" and "keyframe-end" lines
+    };
+    QList<Keyframe> keyframes;
+
+    int prologue; // lines before the seats are arranged, replayed before a keyframe
+    int start_turn;
+    int position, target; // current and fast-forward line indices
+    bool stopped;
+
+    bool isObsolete(const QByteArray &cmd) const;
+    int currentTurn();
+
     QMap<QString, QString> m_nameTranslation;
     QMap<QString, QSanProtocol::CommandType> m_commandMapping;
     QMap<QSanProtocol::PacketType, QList<QSanProtocol::CommandType> > m_packetTypeMapping;
@@ -75,6 +117,7 @@ signals:
     void command_parsed(const QString &cmd);
     void elasped(int secs);
     void speed_changed(qreal speed);
+    void rewind_requested(int turn);
 };
 
 #endif // RECORDER_H
@@ -0,0 +1,305 @@
+#include "replayanalyzer.h"
+#include "recorder.h"
+#include "protocol.h"
+#include "jsonutils.h"
+
+#include <cstdio>
+
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QtConcurrentMap>
+
+using namespace QSanProtocol;
+using namespace QSanProtocol::Utils;
+
+ReplayAnalyzer::GeneralStats::GeneralStats()
+    :games(0), wins(0), turns(0), turn_msecs(0)
+{
+}
+
+ReplayAnalyzer::Stats::Stats()
+    :replays(0), failed(0), turns(0), turn_msecs(0)
+{
+}
+
+void ReplayAnalyzer::Stats::merge(const Stats &other){
+    replays += other.replays;
+    failed += other.failed;
+    turns += other.turns;
+    turn_msecs += other.turn_msecs;
+
+    QHashIterator<QString, GeneralStats> itor(other.generals);
+    while(itor.hasNext()){
+        itor.next();
+
+        GeneralStats &general = generals[itor.key()];
+        general.games += itor.value().games;
+        general.wins += itor.value().wins;
+        general.turns += itor.value().turns;
+        general.turn_msecs += itor.value().turn_msecs;
+    }
+
+    QHashIterator<QString, int> skill_itor(other.skills);
+    while(skill_itor.hasNext()){
+        skill_itor.next();
+        skills[skill_itor.key()] += skill_itor.value();
+    }
+}
+
+ReplayAnalyzer::ReplayAnalyzer(const QString &path, int jobs, const QString &filename)
+    :jobs(jobs), filename(filename)
+{
+    if(this->jobs <= 0)
+        this->jobs = qMax(QThread::idealThreadCount(), 1);
+
+    QFileInfo info(path);
+    if(info.isDir()){
+        QDir dir(path);
+        QStringList filters;
+        filters << "*.txt" << "*.png";
+        foreach(QFileInfo entry, dir.entryInfoList(filters, QDir::Files, QDir::Name))
+            files << entry.absoluteFilePath();
+    }else if(info.isFile())
+        files << info.absoluteFilePath();
+}
+
+ReplayAnalyzer::Stats ReplayAnalyzer::Analyze(const QString &filename){
+    Stats stats;
+
+    QByteArray data;
+    if(filename.endsWith(".png"))
+        data = Replayer::PNG2TXT(filename);
+    else{
+        QFile file(filename);
+        if(file.open(QIODevice::ReadOnly))
+            data = file.readAll();
+    }
+
+    QString self_name, current, winner;
+    QStringList seats, roles;
+    QHash<QString, QString> generals;
+    QHash<QString, int> turns;
+    QHash<QString, qint64> turn_msecs;
+    QHash<QString, int> skills;
+    int elapsed = 0, turn_start = 0;
+    bool in_keyframe = false, over = false;
+
+    foreach(QByteArray line, data.split('\n')){
+        int space = line.indexOf(' ');
+        if(space == -1)
+            continue;
+
+        elapsed = line.left(space).toInt();
+        QByteArray cmd = line.mid(space + 1).trimmed();
+
+        // keyframes repeat what was already recorded
+        if(cmd.startsWith("keyframe ")){
+            in_keyframe = true;
+            continue;
+        }else if(cmd.startsWith("keyframe-end")){
+            in_keyframe = false;
+            continue;
+        }else if(in_keyframe)
+            continue;
+
+        if(cmd.startsWith('[')){
+            QSanGeneralPacket packet;
+            if(!packet.parse(cmd.constData()))
+                continue;
+
+            // invoke skill is also a client request, only the broadcasts count
+            const Json::Value &body = packet.getMessageBody();
+            if(packet.getCommandType() == S_COMMAND_INVOKE_SKILL
+                    && packet.getPacketType() == S_SERVER_NOTIFICATION && isStringArray(body, 0, 1))
+                skills[toQString(body[0])]++;
+            else if(packet.getCommandType() == S_COMMAND_GAME_OVER
+                    && body.isArray() && body.size() >= 2 && body[0].isString()){
+                winner = toQString(body[0]);
+                tryParse(body[1], roles);
+                over = true;
+                break;
+            }
+
+            continue;
+        }
+
+        // ".objectName sgs1", "#sgs2 general caocao", "arrangeSeats sgs1+sgs2"
+        QList<QByteArray> words = cmd.split(' ');
+        QString who, property, value;
+        if(cmd.startsWith('.') && words.length() >= 2){
+            who = self_name;
+            property = words.at(0).mid(1);
+            value = words.at(1);
+        }else if(cmd.startsWith('#') && words.length() >= 3){
+            who = words.at(0).mid(1);
+            property = words.at(1);
+            value = words.at(2);
+        }else if(words.at(0) == "arrangeSeats" && words.length() >= 2){
+            seats = QString(words.at(1)).split("+");
+            continue;
+        }else
+            continue;
+
+        if(property == "objectName")
+            self_name = value;
+        else if(property == "general")
+            generals[who] = value;
+        else if(property == "phase" && value == "round_start"){
+            if(!current.isEmpty()){
+                turns[current]++;
+                turn_msecs[current] += elapsed - turn_start;
+            }
+
+            current = who;
+            turn_start = elapsed;
+        }
+    }
+
+    if(!over || seats.isEmpty() || seats.length() != roles.length()){
+        stats.failed = 1;
+        return stats;
+    }
+
+    if(!current.isEmpty()){
+        turns[current]++;
+        turn_msecs[current] += elapsed - turn_start;
+    }
+
+    stats.replays = 1;
+    stats.skills = skills;
+
+    QStringList winners = winner.split("+");
+    for(int i = 0; i < seats.length(); i++){
+        QString name = seats.at(i);
+        QString general_name = generals.value(name);
+        if(general_name.isEmpty())
+            continue;
+
+        GeneralStats &general = stats.generals[general_name];
+        general.games++;
+        if(winner != "." && (winners.contains(name) || winners.contains(roles.at(i))))
+            general.wins++;
+        general.turns += turns.value(name);
+        general.turn_msecs += turn_msecs.value(name);
+
+        stats.turns += turns.value(name);
+        stats.turn_msecs += turn_msecs.value(name);
+    }
+
+    return stats;
+}
+
+static void MergeStats(ReplayAnalyzer::Stats &result, const ReplayAnalyzer::Stats &stats){
+    result.merge(stats);
+}
+
+bool ReplayAnalyzer::run(){
+    if(files.isEmpty()){
+        printf("No replay found\n");
+        return false;
+    }
+
+    printf("Analyzing %d replays on %d workers\n", files.length(), jobs);
+
+    QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    QElapsedTimer watch;
+    watch.start();
+
+    Stats stats = QtConcurrent::blockingMappedReduced<Stats>(files, Analyze, MergeStats,
+                                                             QtConcurrent::UnorderedReduce | QtConcurrent::SequentialReduce);
+
+    double secs = watch.elapsed() / 1000.0;
+    printf("Analyzed %d replays (%d unreadable) in %.1f seconds, %.1f replays per second\n",
+           stats.replays, stats.failed, secs, secs > 0 ? files.length() / secs : 0.0);
+
+    bool ok = filename.endsWith(".json") ? writeJSON(stats) : writeCSV(stats);
+    if(!ok)
+        printf("Can not write %s\n", qPrintable(filename));
+
+    return ok;
+}
+
+bool ReplayAnalyzer::writeCSV(const Stats &stats) const{
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+
+    QStringList names = stats.generals.keys();
+    names.sort();
+
+    QTextStream stream(&file);
+    stream << "general,games,wins,win_rate,turns,avg_turn_msecs\n";
+    foreach(QString name, names){
+        const GeneralStats &general = stats.generals[name];
+        stream << name << ',' << general.games << ',' << general.wins << ','
+               << QString::number((double)general.wins / general.games, 'f', 4) << ','
+               << general.turns << ','
+               << (general.turns > 0 ? general.turn_msecs / general.turns : 0) << '\n';
+    }
+
+    // the skill table goes next to it, "stats.csv" -> "stats-skills.csv"
+    QString skill_filename = filename;
+    int dot = skill_filename.lastIndexOf('.');
+    if(dot <= skill_filename.lastIndexOf('/'))
+        dot = skill_filename.length();
+    skill_filename.insert(dot, "-skills");
+
+    QFile skill_file(skill_filename);
+    if(!skill_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+
+    names = stats.skills.keys();
+    names.sort();
+
+    QTextStream skill_stream(&skill_file);
+    skill_stream << "skill,invocations,per_game\n";
+    foreach(QString name, names){
+        int invocations = stats.skills.value(name);
+        skill_stream << name << ',' << invocations << ','
+                     << QString::number((double)invocations / qMax(stats.replays, 1), 'f', 4) << '\n';
+    }
+
+    return true;
+}
+
+bool ReplayAnalyzer::writeJSON(const Stats &stats) const{
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+
+    Json::Value root(Json::objectValue);
+    root["replays"] = stats.replays;
+    root["unreadable"] = stats.failed;
+    root["turns"] = stats.turns;
+    root["avg_turn_msecs"] = (int)(stats.turns > 0 ? stats.turn_msecs / stats.turns : 0);
+
+    Json::Value generals(Json::objectValue);
+    QHashIterator<QString, GeneralStats> itor(stats.generals);
+    while(itor.hasNext()){
+        itor.next();
+
+        const GeneralStats &general = itor.value();
+        Json::Value item(Json::objectValue);
+        item["games"] = general.games;
+        item["wins"] = general.wins;
+        item["win_rate"] = (double)general.wins / general.games;
+        item["turns"] = general.turns;
+        item["avg_turn_msecs"] = (int)(general.turns > 0 ? general.turn_msecs / general.turns : 0);
+        generals[itor.key().toAscii().constData()] = item;
+    }
+    root["generals"] = generals;
+
+    Json::Value skills(Json::objectValue);
+    QHashIterator<QString, int> skill_itor(stats.skills);
+    while(skill_itor.hasNext()){
+        skill_itor.next();
+        skills[skill_itor.key().toAscii().constData()] = skill_itor.value();
+    }
+    root["skills"] = skills;
+
+    return file.write(Json::StyledWriter().write(root).c_str()) != -1;
+}
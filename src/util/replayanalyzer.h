@@ -0,0 +1,46 @@
+#ifndef REPLAYANALYZER_H
+#define REPLAYANALYZER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+// Headless batch mode for "-analyze:<dir>". Decodes every .txt/.png record
+// in the directory on `jobs` threads and writes per-general and per-skill
+// tables, as CSV or JSON depending on the output suffix.
+class ReplayAnalyzer
+{
+public:
+    struct GeneralStats{
+        GeneralStats();
+
+        int games, wins;
+        int turns;
+        qint64 turn_msecs;
+    };
+
+    struct Stats{
+        Stats();
+        void merge(const Stats &other);
+
+        int replays, failed, turns;
+        qint64 turn_msecs;
+        QHash<QString, GeneralStats> generals;
+        QHash<QString, int> skills;
+    };
+
+    ReplayAnalyzer(const QString &path, int jobs, const QString &filename);
+    bool run();
+
+    static Stats Analyze(const QString &filename);
+
+private:
+    QStringList files;
+    int jobs;
+    QString filename;
+
+    bool writeCSV(const Stats &stats) const;
+    bool writeJSON(const Stats &stats) const;
+};
+
+#endif // REPLAYANALYZER_H
@@ -26,12 +26,15 @@ public:
     virtual void connectToNode(QString addr, int port) = 0;
     virtual void disconnectFromHost() = 0;
     virtual void send(const QString &message) = 0;
+    virtual void sendLine(const QByteArray &line) = 0;
+    virtual void sendFrame(const QByteArray &payload) = 0;
     virtual bool isConnected() const = 0;
     virtual QString peerName() const = 0;
     virtual QString peerAddress() const = 0;
 
 signals:
     void message_got(char *msg);
+    void frame_got(const QByteArray &payload);
     void error_message(const QString &msg);
     void disconnected();
     void connected();
@@ -99,7 +99,7 @@ bool LuaAI::askForSkillInvoke(const QString &skill_name, const QVariant &data) {
 	lua_pushstring(L, skill_name.toAscii());
 	SWIG_NewPointerObj(L, &data, SWIGTYPE_p_QVariant, 0);
 
-	int error = lua_pcall(L, 3, 1, 0);
+	int error = callLua(L, 3, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -122,7 +122,7 @@ QString LuaAI::askForChoice(const QString &skill_name, const QString &choices, c
    lua_pushstring(L, skill_name.toAscii());
    lua_pushstring(L, choices.toAscii());
    SWIG_NewPointerObj(L, &data, SWIGTYPE_p_QVariant, 0);
-   int error = lua_pcall(L, 4, 1, 0);
+   int error = callLua(L, 4, 1);
    const char *result = lua_tostring(L, -1);
    lua_pop(L, 1);
    if(error){
@@ -140,12 +140,15 @@ void LuaAI::activate(CardUseStruct &card_use) {
 	pushCallback(L, __FUNCTION__);
 	SWIG_NewPointerObj(L, &card_use, SWIGTYPE_p_CardUseStruct, 0);
 
-	int error = lua_pcall(L, 2, 0, 0);
+	int error = callLua(L, 2, 0);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
 		room->output(error_msg);
 
+		// the Lua AI may have filled in part of the use before it failed
+		card_use.card = NULL;
+		card_use.to.clear();
 		TrustAI::activate(card_use);
 	}
 }
@@ -195,12 +198,13 @@ ServerPlayer *LuaAI::askForYiji(const QList<int> &cards, int &card_id){
 		lua_rawseti(L, -2, i+1);
 	}
 
-	int error = lua_pcall(L, 2, 2, 0);
+	int error = callLua(L, 2, 2);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
 		room->output(error_msg);
-		return NULL;
+		card_id = -1;
+		return TrustAI::askForYiji(cards, card_id);
 	}
 
 	void *player_ptr;
@@ -227,7 +231,8 @@ void LuaAI::filterEvent(TriggerEvent event, ServerPlayer *player, const QVariant
 	SWIG_NewPointerObj(L, player, SWIGTYPE_p_ServerPlayer, 0);
 	SWIG_NewPointerObj(L, &data, SWIGTYPE_p_QVariant, 0);
 
-	int error = lua_pcall(L, 4, 0, 0);
+	// events are bookkeeping, not decisions, and are never cut short
+	int error = callLua(L, 4, 0, false);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -243,7 +248,7 @@ const Card *LuaAI::askForCard(const QString &pattern, const QString &prompt, con
 	lua_pushstring(L, prompt.toAscii());
 	SWIG_NewPointerObj(L, &data, SWIGTYPE_p_QVariant, 0);
 
-	int error = lua_pcall(L, 4, 1, 0);
+	int error = callLua(L, 4, 1);
 	const char *result = lua_tostring(L, -1);
 	lua_pop(L, 1);
 	if(error){
@@ -265,7 +270,7 @@ int LuaAI::askForCardChosen(ServerPlayer *who, const QString &flags, const QStri
 	lua_pushstring(L, flags.toAscii());
 	lua_pushstring(L, reason.toAscii());
 
-	int error = lua_pcall(L, 4, 1, 0);
+	int error = callLua(L, 4, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -292,7 +297,7 @@ ServerPlayer *LuaAI::askForPlayerChosen(const QList<ServerPlayer *> &targets, co
 	SWIG_NewPointerObj(L, &targets, SWIGTYPE_p_QListT_ServerPlayer_p_t, 0);
 	lua_pushstring(L, reason.toAscii());
 
-	int error = lua_pcall(L, 3, 1, 0);
+	int error = callLua(L, 3, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -320,7 +325,7 @@ const Card *LuaAI::askForNullification(const TrickCard *trick, ServerPlayer *fro
 	SWIG_NewPointerObj(L, to, SWIGTYPE_p_ServerPlayer, 0);
 	lua_pushboolean(L, positive);
 
-	int error = lua_pcall(L, 5, 1, 0);
+	int error = callLua(L, 5, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -345,7 +350,7 @@ const Card *LuaAI::askForCardShow(ServerPlayer *requestor, const QString &reason
 	SWIG_NewPointerObj(L, requestor, SWIGTYPE_p_ServerPlayer, 0);
 	lua_pushstring(L, reason.toAscii());
 
-	int error = lua_pcall(L, 3, 1, 0);
+	int error = callLua(L, 3, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -368,7 +373,7 @@ const Card *LuaAI::askForSinglePeach(ServerPlayer *dying){
 		pushCallback(L, __FUNCTION__);
 	SWIG_NewPointerObj(L, dying, SWIGTYPE_p_ServerPlayer, 0);
 
-	int error = lua_pcall(L, 2, 1, 0);
+	int error = callLua(L, 2, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -391,7 +396,7 @@ const Card *LuaAI::askForPindian(ServerPlayer *requestor, const QString &reason)
 	SWIG_NewPointerObj(L, requestor, SWIGTYPE_p_ServerPlayer, 0);
 	lua_pushstring(L, reason.toAscii());
 
-	int error = lua_pcall(L, 3, 1, 0);
+	int error = callLua(L, 3, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -414,7 +419,7 @@ Card::Suit LuaAI::askForSuit(const QString &reason){
 
 	pushCallback(L, __FUNCTION__);
 	lua_pushstring(L, reason.toAscii());
-	int error = lua_pcall(L, 2, 1, 0);
+	int error = callLua(L, 2, 1);
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
@@ -214,17 +214,34 @@ bool LuaTriggerSkill::trigger(TriggerEvent event, Room* room, ServerPlayer *play
 
 #include <QMessageBox>
 
+// Every room state runs the same scripts as the engine's state, so a skill's
+// callback references name the same functions in all of them. Callbacks made
+// on a room thread go to that room's state, the rest to the engine's.
+static lua_State *GetLuaState(){
+	Room *room = Room::GetCurrentRoom();
+	if(room && room->getLuaState())
+		return room->getLuaState();
+
+	return Sanguosha->getLuaState();
+}
+
 static void Error(lua_State *L){
 	const char *error_string = lua_tostring(L, -1);
 	lua_pop(L, 1);
-	QMessageBox::warning(NULL, "Lua script error!", error_string);
+
+	// no message box outside the GUI thread
+	Room *room = Room::GetCurrentRoom();
+	if(room)
+		room->output(error_string);
+	else
+		QMessageBox::warning(NULL, "Lua script error!", error_string);
 }
 
 bool LuaProhibitSkill::isProhibited(const Player *from, const Player *to, const Card *card) const{
 	if(is_prohibited == 0)
 		return false;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, is_prohibited);
 
@@ -248,7 +265,7 @@ int LuaDistanceSkill::getCorrect(const Player *from, const Player *to) const{
 	if(correct_func == 0)
 		return 0;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, correct_func);
 
@@ -272,7 +289,7 @@ int LuaMaxCardsSkill::getExtra(const Player *target) const{
 	if(extra_func == 0)
 		return 0;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, extra_func);
 
@@ -295,7 +312,7 @@ bool LuaFilterSkill::viewFilter(const CardItem *to_select) const{
 	if(view_filter == 0)
 		return false;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, view_filter);
 
@@ -317,7 +334,7 @@ const Card *LuaFilterSkill::viewAs(CardItem *card_item) const{
 	if(view_as == 0)
 		return false;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, view_as);
 
@@ -352,7 +369,7 @@ bool LuaViewAsSkill::viewFilter(const QList<CardItem *> &selected, const CardIte
 	if(view_filter == 0)
 		return false;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, view_filter);
 
@@ -384,7 +401,7 @@ const Card *LuaViewAsSkill::viewAs(const QList<CardItem *> &cards) const{
 	if(view_as == 0)
 		return NULL;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, view_as);
 
@@ -418,7 +435,7 @@ bool LuaViewAsSkill::isEnabledAtPlay(const Player *player) const{
 	if(enabled_at_play == 0)
 		return ViewAsSkill::isEnabledAtPlay(player);
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, enabled_at_play);
@@ -442,7 +459,7 @@ bool LuaViewAsSkill::isEnabledAtResponse(const Player *player, const QString &pa
 	if(enabled_at_response == 0)
 		return ViewAsSkill::isEnabledAtResponse(player, pattern);
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, enabled_at_response);
@@ -468,7 +485,7 @@ bool LuaViewAsSkill::isEnabledAtNullification(const Player *player) const{
 	if(enabled_at_nullification == 0)
 		return false;
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, enabled_at_nullification);
@@ -498,7 +515,7 @@ bool LuaSkillCard::targetFilter(const QList<const Player *> &targets, const Play
 	if(filter == 0)
 		return SkillCard::targetFilter(targets, to_select, self);
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 	
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, filter);	
@@ -530,7 +547,7 @@ bool LuaSkillCard::targetsFeasible(const QList<const Player *> &targets, const P
 	if(feasible == 0)
 		return SkillCard::targetsFeasible(targets, self);
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = GetLuaState();
 	
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, feasible);	
@@ -561,7 +578,7 @@ void LuaSkillCard::use(Room *room, ServerPlayer *source, const QList<ServerPlaye
 	if(on_use == 0)
 		return SkillCard::use(room, source, targets);
 
-	lua_State *L = Sanguosha->getLuaState();
+	lua_State *L = room->getLuaState();
 	
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, on_use);
@@ -591,7 +608,8 @@ void LuaSkillCard::onEffect(const CardEffectStruct &effect) const{
 	if(on_effect == 0)
 		return SkillCard::onEffect(effect);
 
-	lua_State *L = Sanguosha->getLuaState();
+	Room *room = effect.to->getRoom();
+	lua_State *L = room->getLuaState();
 	
 	// the callback
 	lua_rawgeti(L, LUA_REGISTRYINDEX, on_effect);
@@ -604,7 +622,6 @@ void LuaSkillCard::onEffect(const CardEffectStruct &effect) const{
 	if(error){
 		const char *error_msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
-		Room *room = effect.to->getRoom();
 		room->output(error_msg);
 	}
 }
@@ -4,6 +4,7 @@
 #include "structs.h"
 #include "engine.h"
 #include "client.h"
+#include "atom.h"
 
 #include <QDir>
 
@@ -32,6 +33,13 @@ public:
 	}
 };
 
+class AtomTable{
+public:
+	static int Intern(const char *name);
+	static int Find(const char *name);
+	static QString Name(int atom);
+};
+
 class General : public QObject
 {
 public:
@@ -125,6 +133,7 @@ public:
 	QString getFlags() const;
 	void setFlags(const char *flag);
 	bool hasFlag(const char *flag) const;
+	bool hasFlag(int flag_atom) const;
 	void clearFlags();
 
 
@@ -142,6 +151,7 @@ public:
 	void loseSkill(const char *skill_name);
 	void loseAllSkills();
 	bool hasSkill(const char *skill_name, bool includelost = false) const;
+	bool hasSkill(int skill_atom, bool includelost = false) const;
 	bool hasLordSkill(const char *skill_name, bool includelost = false) const;
 	bool hasInnateSkill(const char *skill_name) const;
 	
@@ -185,6 +195,7 @@ public:
 	void removeMark(const char *mark);
 	virtual void setMark(const char *mark, int value);
 	int getMark(const char *mark) const;
+	int getMark(int mark_atom) const;
 
 	void setChained(bool chained);
 	bool isChained() const;
@@ -776,6 +787,7 @@ public:
 	virtual int getPriority() const;
 	virtual bool triggerable(const ServerPlayer *target) const;    
 	virtual bool trigger(TriggerEvent event, Room* room, ServerPlayer *player, QVariant &data) const = 0;
+	virtual bool isGlobal() const;
 };
 
 class QThread: public QObject{
@@ -808,6 +820,14 @@ public:
 	void action3v3(ServerPlayer *player);
 };
 
+class RelationTable{
+public:
+	void addIntention(const ServerPlayer *from, const ServerPlayer *to, int intention);
+	int getIntention(const ServerPlayer *from, const ServerPlayer *to) const;
+	int getIntentionCount(const ServerPlayer *from, const ServerPlayer *to) const;
+	QString evaluateRole(const ServerPlayer *player) const;
+};
+
 class Room : public QThread{
 public:
 	explicit Room(QObject *parent, const char *mode);
@@ -886,6 +906,7 @@ public:
 	void transfigure(ServerPlayer *player, const char *new_general, bool full_state, bool invoke_start = true);
 	void swapSeat(ServerPlayer *a, ServerPlayer *b);
 	lua_State *getLuaState() const;
+	RelationTable *getRelationTable();
 	void setFixedDistance(Player *from, const Player *to, int distance);
 	void reverseFor3v3(const Card *card, ServerPlayer *player, QList<ServerPlayer *> &list);
 	bool hasWelfare(const ServerPlayer *player) const;